@@ -0,0 +1,121 @@
+/* termux-elf-cleaner
+
+Copyright (C) 2026 Termux
+
+This file is part of termux-elf-cleaner.
+
+termux-elf-cleaner is free software: you can redistribute it and/or
+modify it under the terms of the GNU General Public License as
+published by the Free Software Foundation, either version 3 of the
+License, or (at your option) any later version.
+
+termux-elf-cleaner is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with termux-elf-cleaner.  If not, see
+<https://www.gnu.org/licenses/>.  */
+
+#include <string.h>
+
+#include "ar-archive.h"
+
+/* Layout of the header before each member, all in ASCII.  */
+struct ar_header {
+	char name[16];
+	char date[12];
+	char uid[6];
+	char gid[6];
+	char mode[8];
+	char size[10];
+	char fmag[2];
+};
+
+static_assert(sizeof(ar_header) == 60);
+
+static bool parse_decimal(char const* field, size_t length, size_t& value)
+{
+	value = 0;
+	size_t i = 0;
+	for (; i < length && field[i] >= '0' && field[i] <= '9'; i++)
+		value = value * 10 + (field[i] - '0');
+	if (i == 0)
+		return false;
+	for (; i < length; i++)
+		if (field[i] != ' ')
+			return false;
+	return true;
+}
+
+static std::string trim_name(char const* name, size_t length)
+{
+	while (length > 0 && name[length - 1] == ' ')
+		length--;
+	// GNU terminates names with a slash, so they may contain spaces.
+	if (length > 0 && name[length - 1] == '/')
+		length--;
+	return std::string(name, length);
+}
+
+bool parse_ar_members(std::span<uint8_t const> bytes, std::vector<ar_member>& members)
+{
+	if (bytes.size() < AR_MAGIC_SIZE || memcmp(bytes.data(), AR_MAGIC, AR_MAGIC_SIZE) != 0)
+		return false;
+
+	std::span<uint8_t const> long_names;
+	size_t offset = AR_MAGIC_SIZE;
+	while (offset < bytes.size()) {
+		if (bytes.size() - offset < sizeof(ar_header))
+			return false;
+		auto const* header = reinterpret_cast<ar_header const*>(bytes.data() + offset);
+		size_t size;
+		if (memcmp(header->fmag, "`\n", 2) != 0 ||
+		    !parse_decimal(header->size, sizeof(header->size), size))
+			return false;
+		offset += sizeof(ar_header);
+		if (size > bytes.size() - offset)
+			return false;
+
+		ar_member member = {offset, size, {}};
+		// Members start at even offsets.
+		offset += size + (size & 1);
+
+		char const* name = header->name;
+		if (name[0] == '/' && (name[1] == ' ' || memcmp(name, "/SYM64/ ", 8) == 0)) {
+			// Symbol table.
+			continue;
+		} else if (name[0] == '/' && name[1] == '/' && name[2] == ' ') {
+			long_names = bytes.subspan(member.offset, member.size);
+			continue;
+		} else if (name[0] == '/' && name[1] >= '0' && name[1] <= '9') {
+			size_t name_offset;
+			if (!parse_decimal(name + 1, sizeof(header->name) - 1, name_offset) ||
+			    name_offset >= long_names.size())
+				return false;
+			auto const* start = reinterpret_cast<char const*>(long_names.data()) + name_offset;
+			auto const* end = static_cast<char const*>(
+				memchr(start, '\n', long_names.size() - name_offset));
+			if (end == nullptr)
+				return false;
+			member.name = trim_name(start, end - start);
+		} else if (memcmp(name, "#1/", 3) == 0) {
+			// BSD puts long names in front of the contents.
+			size_t name_length;
+			if (!parse_decimal(name + 3, sizeof(header->name) - 3, name_length) ||
+			    name_length > member.size)
+				return false;
+			auto const* start = reinterpret_cast<char const*>(bytes.data()) + member.offset;
+			member.name = std::string(start, strnlen(start, name_length));
+			member.offset += name_length;
+			member.size -= name_length;
+			if (member.name.starts_with("__.SYMDEF"))
+				continue;
+		} else {
+			member.name = trim_name(name, sizeof(header->name));
+		}
+		members.push_back(std::move(member));
+	}
+	return true;
+}
@@ -0,0 +1,47 @@
+/* termux-elf-cleaner
+
+Copyright (C) 2026 Termux
+
+This file is part of termux-elf-cleaner.
+
+termux-elf-cleaner is free software: you can redistribute it and/or
+modify it under the terms of the GNU General Public License as
+published by the Free Software Foundation, either version 3 of the
+License, or (at your option) any later version.
+
+termux-elf-cleaner is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with termux-elf-cleaner.  If not, see
+<https://www.gnu.org/licenses/>.  */
+
+#ifndef ELF_CLEANER_AR_ARCHIVE_H
+#define ELF_CLEANER_AR_ARCHIVE_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <span>
+#include <string>
+#include <vector>
+
+#define AR_MAGIC "!<arch>\n"
+#define AR_MAGIC_SIZE 8
+
+struct ar_member {
+	/* Where the member's contents start in the archive, and their size.  */
+	size_t offset;
+	size_t size;
+	std::string name;
+};
+
+/* Read the member headers of the ar archive in bytes, which starts with
+   AR_MAGIC, into members.  GNU and BSD long names are resolved; symbol
+   tables and the GNU long name table are left out.  Returns false if
+   the archive is malformed.  */
+bool parse_ar_members(std::span<uint8_t const> bytes, std::vector<ar_member>& members);
+
+#endif
@@ -0,0 +1,489 @@
+/* termux-elf-cleaner
+
+Copyright (C) 2026 Termux
+
+This file is part of termux-elf-cleaner.
+
+termux-elf-cleaner is free software: you can redistribute it and/or
+modify it under the terms of the GNU General Public License as
+published by the Free Software Foundation, either version 3 of the
+License, or (at your option) any later version.
+
+termux-elf-cleaner is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with termux-elf-cleaner.  If not, see
+<https://www.gnu.org/licenses/>.  */
+
+/* Benchmarks for termux-elf-cleaner:
+
+   - process_elf: libelfcleaner's clean() on ELF32 and ELF64 buffers in
+     memory, both on files that need cleaning and on clean ones.
+   - parse_file: the termux-elf-cleaner binary run end to end on copies
+     of a corpus, for each I/O engine, with a hot and a cold page cache,
+     sweeping --jobs from 1 to N.
+   - order: the same with the copies given smallest first as arguments,
+     started in that order and largest first, which matters most on
+     corpora of very different file sizes.
+
+   Results go to stdout as a table and optionally to a JSON file that
+   can be compared between releases.  */
+
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE
+#endif
+
+#include <dirent.h>
+#include <fcntl.h>
+#include <getopt.h>
+#include <spawn.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "elfcleaner.h"
+
+extern char **environ;
+
+static char const *const usage_message[] =
+{ "\
+\n\
+Benchmarks libelfcleaner in memory and termux-elf-cleaner on copies of\n\
+the files in a corpus directory.\n\
+\n\
+Options:\n\
+\n\
+--cleaner PATH        termux-elf-cleaner binary to run (required)\n\
+--corpus DIR          directory with the input files (required)\n\
+--work-dir DIR        where the copies are made (required)\n\
+--copies N            copies of every corpus file, default 50\n\
+--max-jobs N          sweep --jobs over 1, 2, 4, .. up to N, default\n\
+                      the number of CPUs\n\
+--runs N              runs per measurement, the fastest is kept,\n\
+                      default 3\n\
+--iterations N        calls per in-memory measurement, default 2000\n\
+--api-level NN        api level to clean for, default 21\n\
+--json FILE           also write the results to FILE as JSON\n\
+--help                display this help and exit\n"
+};
+
+struct corpus_file {
+	std::string path;
+	std::vector<uint8_t> bytes;
+};
+
+struct memory_result {
+	char const* elf_class;
+	char const* input;
+	size_t files;
+	size_t bytes;
+	long iterations;
+	double seconds;
+};
+
+struct order_result {
+	char const* order;
+	int jobs;
+	size_t files;
+	double seconds;
+};
+
+struct end_to_end_result {
+	char const* engine;
+	char const* cache;
+	char const* input;
+	int jobs;
+	size_t files;
+	double bytes;
+	double seconds;
+};
+
+static double now()
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static bool read_file(char const* path, std::vector<uint8_t>& bytes)
+{
+	int fd = open(path, O_RDONLY);
+	if (fd < 0) {
+		perror(path);
+		return false;
+	}
+	uint8_t buffer[64 * 1024];
+	ssize_t n;
+	while ((n = read(fd, buffer, sizeof(buffer))) > 0)
+		bytes.insert(bytes.end(), buffer, buffer + n);
+	close(fd);
+	if (n < 0) {
+		perror(path);
+		return false;
+	}
+	return true;
+}
+
+static bool write_file(char const* path, std::vector<uint8_t> const& bytes)
+{
+	int fd = open(path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+	if (fd < 0) {
+		perror(path);
+		return false;
+	}
+	bool ok = write(fd, bytes.data(), bytes.size()) == (ssize_t) bytes.size();
+	if (!ok)
+		perror(path);
+	close(fd);
+	return ok;
+}
+
+/* Write back and drop the cached pages of path, so the next access has
+   to read it from storage.  */
+static void evict(char const* path)
+{
+	int fd = open(path, O_RDONLY);
+	if (fd < 0)
+		return;
+	fdatasync(fd);
+	posix_fadvise(fd, 0, 0, POSIX_FADV_DONTNEED);
+	close(fd);
+}
+
+/* Read path so that its pages are cached.  */
+static void warm(char const* path)
+{
+	int fd = open(path, O_RDONLY);
+	if (fd < 0)
+		return;
+	char buffer[64 * 1024];
+	while (read(fd, buffer, sizeof(buffer)) > 0)
+		;
+	close(fd);
+}
+
+/* Run cleaner on the files in list, or on files given as arguments if
+   list is nullptr, passing --order if order is not nullptr, and return
+   the seconds it took.  */
+static double run_cleaner(char const* cleaner, char const* engine, int jobs,
+			  char const* api_level, char const* list,
+			  char const* order = nullptr,
+			  std::vector<std::string> const* files = nullptr)
+{
+	std::string const jobs_arg = std::to_string(jobs);
+	std::vector<char const*> argv = {
+		cleaner, "--quiet", "--io-engine", engine, "--jobs", jobs_arg.c_str(),
+		"--api-level", api_level
+	};
+	if (order != nullptr) {
+		argv.push_back("--order");
+		argv.push_back(order);
+	}
+	if (list != nullptr) {
+		argv.push_back("--files-from");
+		argv.push_back(list);
+	} else {
+		for (auto const& file : *files)
+			argv.push_back(file.c_str());
+	}
+	argv.push_back(nullptr);
+	double const start = now();
+	pid_t pid;
+	if (posix_spawn(&pid, cleaner, nullptr, nullptr,
+			const_cast<char**>(argv.data()), environ) != 0) {
+		perror(cleaner);
+		exit(1);
+	}
+	int status;
+	waitpid(pid, &status, 0);
+	double const elapsed = now() - start;
+	if (!WIFEXITED(status) || WEXITSTATUS(status) != 0) {
+		fprintf(stderr, "%s exited with status %d\n", cleaner, status);
+		exit(1);
+	}
+	return elapsed;
+}
+
+/* Time clean() on every ELF file of the given class in the corpus,
+   restoring the original bytes between calls outside the timed part.  */
+static memory_result bench_memory(std::vector<corpus_file> const& corpus, uint8_t elf_class,
+				  bool already_clean, long iterations,
+				  elfcleaner::options const& opts)
+{
+	memory_result res = {elf_class == 1 ? "ELF32" : "ELF64",
+			     already_clean ? "clean" : "dirty", 0, 0, 0, 0};
+	std::vector<std::vector<uint8_t>> inputs;
+	for (auto const& file : corpus) {
+		if (file.bytes.size() < 64 || memcmp(file.bytes.data(), "\177ELF", 4) != 0 ||
+		    file.bytes[4] != elf_class)
+			continue;
+		std::vector<uint8_t> input = file.bytes;
+		if (already_clean)
+			elfcleaner::clean(input, opts);
+		inputs.push_back(std::move(input));
+		res.bytes += file.bytes.size();
+	}
+	res.files = inputs.size();
+	if (inputs.empty())
+		return res;
+
+	std::vector<uint8_t> work;
+	for (long i = 0; i < iterations; i++) {
+		auto const& input = inputs[i % inputs.size()];
+		work = input;
+		double const start = now();
+		elfcleaner::clean(work, opts);
+		res.seconds += now() - start;
+	}
+	res.iterations = iterations;
+	return res;
+}
+
+int main(int argc, char **argv)
+{
+	char const* cleaner = nullptr;
+	char const* corpus_dir = nullptr;
+	char const* work_dir = nullptr;
+	char const* json_file = nullptr;
+	char const* api_level = "21";
+	int copies = 50;
+	int runs = 3;
+	long iterations = 2000;
+	int max_jobs = std::max(1u, std::thread::hardware_concurrency());
+
+	static struct option options[] = {
+		{"cleaner", required_argument, NULL, 'c'},
+		{"corpus", required_argument, NULL, 'C'},
+		{"work-dir", required_argument, NULL, 'w'},
+		{"copies", required_argument, NULL, 'n'},
+		{"max-jobs", required_argument, NULL, 'j'},
+		{"runs", required_argument, NULL, 'r'},
+		{"iterations", required_argument, NULL, 'i'},
+		{"api-level", required_argument, NULL, 'a'},
+		{"json", required_argument, NULL, 'J'},
+		{"help", no_argument, NULL, 'h'},
+		{0, 0, 0, 0}
+	};
+
+	int c;
+	while ((c = getopt_long(argc, argv, "h", options, NULL)) != -1) {
+		switch (c) {
+		case 'c': cleaner = optarg; break;
+		case 'C': corpus_dir = optarg; break;
+		case 'w': work_dir = optarg; break;
+		case 'n': copies = std::max(1, atoi(optarg)); break;
+		case 'j': max_jobs = std::max(1, atoi(optarg)); break;
+		case 'r': runs = std::max(1, atoi(optarg)); break;
+		case 'i': iterations = std::max(1L, atol(optarg)); break;
+		case 'a': api_level = optarg; break;
+		case 'J': json_file = optarg; break;
+		case 'h':
+			printf("Usage: %s [OPTION]...\n", argv[0]);
+			for (auto line : usage_message)
+				fputs(line, stdout);
+			return 0;
+		default:
+			return 1;
+		}
+	}
+	if (cleaner == nullptr || corpus_dir == nullptr || work_dir == nullptr) {
+		fprintf(stderr, "%s: --cleaner, --corpus and --work-dir are required\n", argv[0]);
+		return 1;
+	}
+
+	std::vector<corpus_file> corpus;
+	DIR* dir = opendir(corpus_dir);
+	if (dir == nullptr) {
+		perror(corpus_dir);
+		return 1;
+	}
+	while (struct dirent* entry = readdir(dir)) {
+		std::string path = std::string(corpus_dir) + "/" + entry->d_name;
+		struct stat st;
+		if (stat(path.c_str(), &st) != 0 || !S_ISREG(st.st_mode))
+			continue;
+		corpus_file file;
+		file.path = path;
+		if (!read_file(path.c_str(), file.bytes))
+			return 1;
+		corpus.push_back(std::move(file));
+	}
+	closedir(dir);
+	std::sort(corpus.begin(), corpus.end(), [](corpus_file const& a, corpus_file const& b) {
+		return a.path < b.path;
+	});
+
+	elfcleaner::options const opts = elfcleaner::make_options(atoi(api_level));
+	std::vector<memory_result> memory_results;
+	printf("%-10s %-6s %-5s %8s %12s %10s\n",
+	       "benchmark", "class", "input", "files", "ns/call", "MB/s");
+	for (uint8_t elf_class : {1, 2}) {
+		for (bool already_clean : {false, true}) {
+			memory_result res = bench_memory(corpus, elf_class, already_clean, iterations, opts);
+			if (res.files == 0)
+				continue;
+			double const ns_per_call = res.seconds / res.iterations * 1e9;
+			double const mean_size = (double) res.bytes / res.files;
+			printf("%-10s %-6s %-5s %8zu %12.0f %10.1f\n",
+			       "process_elf", res.elf_class, res.input, res.files, ns_per_call,
+			       mean_size / (ns_per_call / 1e9) / (1024 * 1024));
+			memory_results.push_back(res);
+		}
+	}
+	printf("\n");
+
+	mkdir(work_dir, 0755);
+	std::string const list = std::string(work_dir) + "/files";
+	FILE* list_file = fopen(list.c_str(), "w");
+	if (list_file == nullptr) {
+		perror(list.c_str());
+		return 1;
+	}
+	std::vector<std::pair<corpus_file const*, std::string>> copies_of;
+	double total_bytes = 0;
+	for (int i = 0; i < copies; i++) {
+		for (size_t j = 0; j < corpus.size(); j++) {
+			std::string copy = std::string(work_dir) + "/" + std::to_string(i) + "-" + std::to_string(j);
+			copies_of.emplace_back(&corpus[j], copy);
+			fprintf(list_file, "%s\n", copy.c_str());
+			total_bytes += corpus[j].bytes.size();
+		}
+	}
+	fclose(list_file);
+
+	std::vector<int> job_counts;
+	for (int jobs = 1; jobs < max_jobs; jobs *= 2)
+		job_counts.push_back(jobs);
+	job_counts.push_back(max_jobs);
+
+	std::vector<end_to_end_result> end_to_end_results;
+	printf("%-10s %-6s %-5s %-5s %4s %8s %10s %10s %10s\n",
+	       "benchmark", "engine", "cache", "input", "jobs", "files", "seconds",
+	       "files/s", "MB/s");
+	for (char const* engine : {"mmap", "pread", "uring"}) {
+		for (bool cold : {false, true}) {
+			for (bool already_clean : {false, true}) {
+				for (int jobs : job_counts) {
+					double best = 0;
+					for (int run = 0; run < runs; run++) {
+						for (auto const& [file, copy] : copies_of)
+							if (!write_file(copy.c_str(), file->bytes))
+								return 1;
+						if (already_clean)
+							run_cleaner(cleaner, engine, jobs, api_level, list.c_str());
+						for (auto const& entry : copies_of) {
+							if (cold)
+								evict(entry.second.c_str());
+							else
+								warm(entry.second.c_str());
+						}
+						double const elapsed = run_cleaner(cleaner, engine, jobs,
+										   api_level, list.c_str());
+						if (run == 0 || elapsed < best)
+							best = elapsed;
+					}
+					end_to_end_result const res = {
+						engine, cold ? "cold" : "hot", already_clean ? "clean" : "dirty",
+						jobs, copies_of.size(), total_bytes, best
+					};
+					printf("%-10s %-6s %-5s %-5s %4d %8zu %10.4f %10.0f %10.1f\n",
+					       "parse_file", res.engine, res.cache, res.input, res.jobs,
+					       res.files, res.seconds, res.files / res.seconds,
+					       res.bytes / res.seconds / (1024 * 1024));
+					end_to_end_results.push_back(res);
+				}
+			}
+		}
+	}
+
+	// Given smallest first, the largest files are started last and
+	// hold up the end of the run unless they are started first.  They
+	// are given as arguments, since names read with --files-from are
+	// only reordered in small windows.
+	auto sorted = copies_of;
+	std::stable_sort(sorted.begin(), sorted.end(), [](auto const& a, auto const& b) {
+		return a.first->bytes.size() < b.first->bytes.size();
+	});
+	std::vector<std::string> by_size;
+	for (auto const& entry : sorted)
+		by_size.push_back(entry.second);
+
+	std::vector<order_result> order_results;
+	printf("\n%-10s %-7s %4s %8s %10s\n", "benchmark", "order", "jobs", "files", "seconds");
+	for (char const* order : {"given", "largest"}) {
+		for (int jobs : job_counts) {
+			double best = 0;
+			for (int run = 0; run < runs; run++) {
+				for (auto const& [file, copy] : copies_of) {
+					if (!write_file(copy.c_str(), file->bytes))
+						return 1;
+					warm(copy.c_str());
+				}
+				double const elapsed = run_cleaner(cleaner, "mmap", jobs, api_level,
+								   nullptr, order, &by_size);
+				if (run == 0 || elapsed < best)
+					best = elapsed;
+			}
+			order_result const res = {order, jobs, copies_of.size(), best};
+			printf("%-10s %-7s %4d %8zu %10.4f\n",
+			       "order", res.order, res.jobs, res.files, res.seconds);
+			order_results.push_back(res);
+		}
+	}
+
+	for (auto const& entry : copies_of)
+		unlink(entry.second.c_str());
+	unlink(list.c_str());
+
+	if (json_file != nullptr) {
+		FILE* json = fopen(json_file, "w");
+		if (json == nullptr) {
+			perror(json_file);
+			return 1;
+		}
+		fprintf(json, "{\n  \"version\": \"%s\",\n  \"api_level\": %s,\n",
+			PACKAGE_VERSION, api_level);
+		fprintf(json, "  \"process_elf\": [");
+		for (size_t i = 0; i < memory_results.size(); i++) {
+			auto const& res = memory_results[i];
+			double const ns_per_call = res.seconds / res.iterations * 1e9;
+			fprintf(json, "%s\n    {\"class\": \"%s\", \"input\": \"%s\", \"files\": %zu, "
+				"\"iterations\": %ld, \"ns_per_call\": %.1f, \"mb_per_second\": %.1f}",
+				i ? "," : "", res.elf_class, res.input, res.files, res.iterations,
+				ns_per_call,
+				(double) res.bytes / res.files / (ns_per_call / 1e9) / (1024 * 1024));
+		}
+		fprintf(json, "\n  ],\n  \"parse_file\": [");
+		for (size_t i = 0; i < end_to_end_results.size(); i++) {
+			auto const& res = end_to_end_results[i];
+			fprintf(json, "%s\n    {\"engine\": \"%s\", \"cache\": \"%s\", \"input\": \"%s\", "
+				"\"jobs\": %d, \"files\": %zu, \"seconds\": %.6f, "
+				"\"files_per_second\": %.1f, \"mb_per_second\": %.1f}",
+				i ? "," : "", res.engine, res.cache, res.input, res.jobs, res.files,
+				res.seconds, res.files / res.seconds,
+				res.bytes / res.seconds / (1024 * 1024));
+		}
+		fprintf(json, "\n  ],\n  \"order\": [");
+		for (size_t i = 0; i < order_results.size(); i++) {
+			auto const& res = order_results[i];
+			fprintf(json, "%s\n    {\"order\": \"%s\", \"jobs\": %d, \"files\": %zu, "
+				"\"seconds\": %.6f}",
+				i ? "," : "", res.order, res.jobs, res.files, res.seconds);
+		}
+		fprintf(json, "\n  ]\n}\n");
+		fclose(json);
+	}
+	return 0;
+}
@@ -0,0 +1,312 @@
+/* termux-elf-cleaner
+
+Copyright (C) 2026 Termux
+
+This file is part of termux-elf-cleaner.
+
+termux-elf-cleaner is free software: you can redistribute it and/or
+modify it under the terms of the GNU General Public License as
+published by the Free Software Foundation, either version 3 of the
+License, or (at your option) any later version.
+
+termux-elf-cleaner is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with termux-elf-cleaner.  If not, see
+<https://www.gnu.org/licenses/>.  */
+
+/* Writes synthetic ELF files for termux-elf-cleaner's tests and
+   benchmarks.  Every file has a PT_PHDR, a PT_LOAD covering the file, a
+   PT_DYNAMIC and optionally a PT_TLS segment, a dynamic section and any
+   number of section headers, which use extended numbering from
+   SHN_LORESERVE sections on.  Files that are not already clean get one
+   of each dynamic entry and section type that is removed, spread over
+   the tables with the last one near the end, an unsupported DF_1_PIE
+   flag and an underaligned TLS segment.  */
+
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE
+#endif
+
+#include <fcntl.h>
+#include <getopt.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <string>
+#include <vector>
+
+#include "elf.h"
+
+static char const *const usage_message[] =
+{ "\
+\n\
+Writes synthetic ELF files named <arch>-<n> to a directory.\n\
+\n\
+Options:\n\
+\n\
+--output-dir DIR      directory to write the files to (required)\n\
+--arches LIST         comma separated architectures, default\n\
+                      " ELF_CLEANER_ARCHES "\n\
+--count N             files per architecture, default 10\n\
+--sections N          section headers per file, default 32\n\
+--dynamic-entries N   dynamic section entries per file, default 32\n\
+--tls                 add a PT_TLS segment\n\
+--size BYTES          pad every file to at least BYTES\n\
+--clean-ratio R       fraction of the files that need no changes,\n\
+                      from 0 to 1, default 0\n\
+--help                display this help and exit\n"
+};
+
+struct arch_info {
+	char const* name;
+	uint8_t elf_class;
+	uint16_t machine;
+};
+
+static arch_info const known_arches[] = {
+	{"aarch64", ELFCLASS64, EM_AARCH64},
+	{"arm", ELFCLASS32, EM_ARM},
+	{"i686", ELFCLASS32, EM_386},
+	{"x86_64", ELFCLASS64, EM_X86_64},
+};
+
+struct params {
+	size_t sections = 32;
+	size_t dynamic_entries = 32;
+	bool tls = false;
+	size_t size = 0;
+};
+
+static size_t align8(size_t n)
+{
+	return (n + 7) & ~size_t(7);
+}
+
+template<typename ElfHeaderType, typename ElfSectionHeaderType,
+	 typename ElfProgramHeaderType, typename ElfDynamicSectionEntryType>
+std::vector<uint8_t> generate(arch_info const& arch, params const& p, bool clean)
+{
+	size_t const program_header_count = p.tls ? 4 : 3;
+	size_t const program_header_offset = sizeof(ElfHeaderType);
+	size_t const dynamic_offset = align8(program_header_offset +
+					     program_header_count * sizeof(ElfProgramHeaderType));
+	size_t const dynamic_size = p.dynamic_entries * sizeof(ElfDynamicSectionEntryType);
+	size_t const section_headers_size = p.sections * sizeof(ElfSectionHeaderType);
+	size_t section_header_offset = align8(dynamic_offset + dynamic_size);
+	if (p.size > section_header_offset + section_headers_size)
+		section_header_offset = align8(p.size - section_headers_size);
+	size_t const file_size = section_header_offset + section_headers_size;
+
+	std::vector<uint8_t> bytes(file_size);
+	auto* elf_hdr = reinterpret_cast<ElfHeaderType*>(bytes.data());
+	memcpy(elf_hdr->e_ident, ELFMAG, SELFMAG);
+	elf_hdr->e_ident[EI_CLASS] = arch.elf_class;
+	elf_hdr->e_ident[EI_DATA] = ELFDATA2LSB;
+	elf_hdr->e_ident[EI_VERSION] = EV_CURRENT;
+	elf_hdr->e_ident[EI_OSABI] = ELFOSABI_NONE;
+	elf_hdr->e_type = ET_DYN;
+	elf_hdr->e_machine = arch.machine;
+	elf_hdr->e_version = EV_CURRENT;
+	elf_hdr->e_phoff = program_header_offset;
+	elf_hdr->e_shoff = p.sections ? section_header_offset : 0;
+	elf_hdr->e_ehsize = sizeof(ElfHeaderType);
+	elf_hdr->e_phentsize = sizeof(ElfProgramHeaderType);
+	elf_hdr->e_phnum = program_header_count;
+	elf_hdr->e_shentsize = sizeof(ElfSectionHeaderType);
+	elf_hdr->e_shnum = p.sections < SHN_LORESERVE ? p.sections : 0;
+	elf_hdr->e_shstrndx = SHN_UNDEF;
+
+	auto* program_headers = reinterpret_cast<ElfProgramHeaderType*>(
+		bytes.data() + program_header_offset);
+	program_headers[0].p_type = PT_PHDR;
+	program_headers[0].p_offset = program_header_offset;
+	program_headers[0].p_filesz = program_header_count * sizeof(ElfProgramHeaderType);
+	program_headers[0].p_align = 8;
+	program_headers[1].p_type = PT_LOAD;
+	program_headers[1].p_filesz = file_size;
+	program_headers[1].p_memsz = file_size;
+	program_headers[1].p_align = 4096;
+	program_headers[2].p_type = PT_DYNAMIC;
+	program_headers[2].p_offset = dynamic_offset;
+	program_headers[2].p_filesz = dynamic_size;
+	program_headers[2].p_memsz = dynamic_size;
+	program_headers[2].p_align = 8;
+	if (p.tls) {
+		program_headers[3].p_type = PT_TLS;
+		program_headers[3].p_memsz = 64;
+		// termux-elf-cleaner raises the alignment to the word size in bits.
+		program_headers[3].p_align = clean ? arch.elf_class * 32 : 8;
+	}
+
+	if (p.dynamic_entries > 0) {
+		std::vector<int64_t> removed_tags = {
+			DT_GNU_HASH, DT_VERSYM, DT_VERNEED, DT_VERNEEDNUM,
+			DT_VERDEF, DT_VERDEFNUM, DT_RPATH, DT_RUNPATH,
+		};
+		if (arch.machine == EM_AARCH64) {
+			removed_tags.push_back(DT_AARCH64_BTI_PLT);
+			removed_tags.push_back(DT_AARCH64_PAC_PLT);
+			removed_tags.push_back(DT_AARCH64_VARIANT_PCS);
+		}
+		removed_tags.push_back(DT_FLAGS_1);
+
+		auto* dynamic_section = reinterpret_cast<ElfDynamicSectionEntryType*>(
+			bytes.data() + dynamic_offset);
+		// The last entry stays DT_NULL.
+		size_t const slots = p.dynamic_entries - 1;
+		size_t const stride = std::max<size_t>(1, slots / removed_tags.size());
+		size_t next_removed = 0;
+		for (size_t j = 0; j < slots; j++) {
+			ElfDynamicSectionEntryType& entry = dynamic_section[j];
+			if (!clean && next_removed < removed_tags.size() &&
+			    (j % stride == 0 || slots - j <= removed_tags.size() - next_removed)) {
+				entry.d_tag = removed_tags[next_removed++];
+				entry.d_un.d_val = entry.d_tag == DT_FLAGS_1 ? DF_1_NOW | DF_1_PIE : j;
+			} else if (clean && j == 0) {
+				entry.d_tag = DT_FLAGS_1;
+				entry.d_un.d_val = DF_1_NOW;
+			} else {
+				entry.d_tag = DT_NEEDED;
+				entry.d_un.d_val = j;
+			}
+		}
+	}
+
+	if (p.sections > 0) {
+		auto* section_headers = reinterpret_cast<ElfSectionHeaderType*>(
+			bytes.data() + section_header_offset);
+		if (p.sections >= SHN_LORESERVE)
+			section_headers[0].sh_size = p.sections;
+		uint32_t const removed_types[] = {SHT_GNU_versym, SHT_GNU_verneed, SHT_GNU_verdef};
+		size_t const removed_count = sizeof(removed_types) / sizeof(removed_types[0]);
+		size_t const stride = std::max<size_t>(1, p.sections / removed_count);
+		size_t next_removed = 0;
+		for (size_t i = 1; i < p.sections; i++) {
+			ElfSectionHeaderType& section = section_headers[i];
+			if (i == 1) {
+				section.sh_type = SHT_DYNAMIC;
+				section.sh_offset = dynamic_offset;
+				section.sh_size = dynamic_size;
+				section.sh_entsize = sizeof(ElfDynamicSectionEntryType);
+			} else if (!clean && next_removed < removed_count &&
+				   (i % stride == 0 || p.sections - i <= removed_count - next_removed)) {
+				section.sh_type = removed_types[next_removed++];
+			} else {
+				section.sh_type = SHT_PROGBITS;
+			}
+		}
+	}
+	return bytes;
+}
+
+static bool write_file(char const* path, std::vector<uint8_t> const& bytes)
+{
+	int fd = open(path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+	if (fd < 0) {
+		perror(path);
+		return false;
+	}
+	size_t written = 0;
+	while (written < bytes.size()) {
+		ssize_t n = write(fd, bytes.data() + written, bytes.size() - written);
+		if (n < 0) {
+			perror(path);
+			close(fd);
+			return false;
+		}
+		written += n;
+	}
+	close(fd);
+	return true;
+}
+
+int main(int argc, char **argv)
+{
+	char const* output_dir = nullptr;
+	std::string arches = ELF_CLEANER_ARCHES;
+	long count = 10;
+	double clean_ratio = 0;
+	params p;
+
+	static struct option options[] = {
+		{"output-dir", required_argument, NULL, 'o'},
+		{"arches", required_argument, NULL, 'A'},
+		{"count", required_argument, NULL, 'n'},
+		{"sections", required_argument, NULL, 's'},
+		{"dynamic-entries", required_argument, NULL, 'd'},
+		{"tls", no_argument, NULL, 't'},
+		{"size", required_argument, NULL, 'S'},
+		{"clean-ratio", required_argument, NULL, 'r'},
+		{"help", no_argument, NULL, 'h'},
+		{0, 0, 0, 0}
+	};
+
+	int c;
+	while ((c = getopt_long(argc, argv, "h", options, NULL)) != -1) {
+		switch (c) {
+		case 'o': output_dir = optarg; break;
+		case 'A': arches = optarg; break;
+		case 'n': count = std::max(0L, atol(optarg)); break;
+		case 's': p.sections = strtoull(optarg, NULL, 10); break;
+		case 'd': p.dynamic_entries = strtoull(optarg, NULL, 10); break;
+		case 't': p.tls = true; break;
+		case 'S': p.size = strtoull(optarg, NULL, 10); break;
+		case 'r': clean_ratio = std::min(1.0, std::max(0.0, atof(optarg))); break;
+		case 'h':
+			printf("Usage: %s [OPTION]...\n", argv[0]);
+			for (auto line : usage_message)
+				fputs(line, stdout);
+			return 0;
+		default:
+			return 1;
+		}
+	}
+	if (output_dir == nullptr) {
+		fprintf(stderr, "%s: --output-dir is required\n", argv[0]);
+		return 1;
+	}
+	if (p.sections == 1) {
+		fprintf(stderr, "%s: --sections must be 0 or at least 2\n", argv[0]);
+		return 1;
+	}
+	mkdir(output_dir, 0755);
+
+	size_t start = 0;
+	while (start <= arches.size()) {
+		size_t end = arches.find(',', start);
+		if (end == std::string::npos)
+			end = arches.size();
+		std::string const name = arches.substr(start, end - start);
+		start = end + 1;
+
+		arch_info const* arch = nullptr;
+		for (auto const& known : known_arches)
+			if (name == known.name)
+				arch = &known;
+		if (arch == nullptr) {
+			fprintf(stderr, "%s: Unknown architecture '%s'\n", argv[0], name.c_str());
+			return 1;
+		}
+
+		for (long i = 0; i < count; i++) {
+			// Spread the clean files evenly over the sequence.
+			bool const clean = (long) ((i + 1) * clean_ratio) > (long) (i * clean_ratio);
+			std::vector<uint8_t> const bytes = arch->elf_class == ELFCLASS32
+				? generate<Elf32_Ehdr, Elf32_Shdr, Elf32_Phdr, Elf32_Dyn>(*arch, p, clean)
+				: generate<Elf64_Ehdr, Elf64_Shdr, Elf64_Phdr, Elf64_Dyn>(*arch, p, clean);
+			char path[4096];
+			snprintf(path, sizeof(path), "%s/%s-%04ld", output_dir, arch->name, i);
+			if (!write_file(path, bytes))
+				return 1;
+		}
+	}
+	return 0;
+}
@@ -0,0 +1,624 @@
+/* termux-elf-cleaner
+
+Copyright (C) 2026 Termux
+
+This file is part of termux-elf-cleaner.
+
+termux-elf-cleaner is free software: you can redistribute it and/or
+modify it under the terms of the GNU General Public License as
+published by the Free Software Foundation, either version 3 of the
+License, or (at your option) any later version.
+
+termux-elf-cleaner is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with termux-elf-cleaner.  If not, see
+<https://www.gnu.org/licenses/>.  */
+
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE
+#endif
+
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <poll.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <set>
+#include <string>
+#include <string_view>
+#include <thread>
+
+#include "daemon.h"
+#include "elf-cleaner.h"
+#include "file-log.h"
+#include "stats.h"
+#include "stop-signal.h"
+#include "worker-pool.h"
+
+/* Longest request line: a path and its keyword.  */
+#define MAX_LINE (PATH_MAX + 16)
+
+/* Most descriptors taken from a single recvmsg().  */
+#define MAX_PASSED_FDS 64
+
+namespace {
+
+bool send_all(int fd, char const* data, size_t size)
+{
+	while (size > 0) {
+		ssize_t const n = send(fd, data, size, MSG_NOSIGNAL);
+		if (n < 0 && errno == EINTR)
+			continue;
+		if (n <= 0)
+			return false;
+		data += n;
+		size -= n;
+	}
+	return true;
+}
+
+/* Splits what a client sends into lines, and queues the descriptors
+   passed along with them in the order they arrive.  */
+class line_reader {
+public:
+	explicit line_reader(int fd) : fd(fd) {}
+
+	~line_reader()
+	{
+		for (int passed : fds)
+			close(passed);
+	}
+
+	/* Read the next line, without its newline.  Returns false at the
+	   end of the connection, or on a line that is too long.  */
+	bool next(std::string& line)
+	{
+		while (true) {
+			size_t const end = buffer.find('\n');
+			if (end != std::string::npos) {
+				line.assign(buffer, 0, end);
+				buffer.erase(0, end + 1);
+				return true;
+			}
+			if (buffer.size() > MAX_LINE || !receive())
+				return false;
+		}
+	}
+
+	/* The next descriptor passed, or -1 if there is none.  */
+	int take_fd()
+	{
+		if (fds.empty())
+			return -1;
+		int const passed = fds.front();
+		fds.pop_front();
+		return passed;
+	}
+
+private:
+	bool receive()
+	{
+		char data[4096];
+		union {
+			struct cmsghdr align;
+			char buf[CMSG_SPACE(MAX_PASSED_FDS * sizeof(int))];
+		} control;
+		struct iovec iov = {data, sizeof(data)};
+		struct msghdr msg = {};
+		msg.msg_iov = &iov;
+		msg.msg_iovlen = 1;
+		msg.msg_control = control.buf;
+		msg.msg_controllen = sizeof(control.buf);
+
+		ssize_t n;
+		do {
+			n = recvmsg(fd, &msg, MSG_CMSG_CLOEXEC);
+		} while (n < 0 && errno == EINTR);
+		if (n <= 0)
+			return false;
+
+		for (struct cmsghdr* c = CMSG_FIRSTHDR(&msg); c != NULL; c = CMSG_NXTHDR(&msg, c)) {
+			if (c->cmsg_level != SOL_SOCKET || c->cmsg_type != SCM_RIGHTS)
+				continue;
+			size_t const count = (c->cmsg_len - CMSG_LEN(0)) / sizeof(int);
+			for (size_t i = 0; i < count; i++) {
+				int passed;
+				memcpy(&passed, CMSG_DATA(c) + i * sizeof(int), sizeof(int));
+				fds.push_back(passed);
+			}
+		}
+		buffer.append(data, n);
+		return true;
+	}
+
+	int fd;
+	std::string buffer;
+	std::deque<int> fds;
+};
+
+/* One client connection.  Its files are cleaned on the pool, and their
+   records come back through write() in order, to be framed and sent by
+   the thread serving the connection, so a slow client never holds up
+   the output of the others.  */
+class session : public log_sink {
+public:
+	session(int fd, worker_pool& pool) : fd(fd), pool(pool), reader(fd) {}
+
+	bool json() const override { return request.json; }
+
+	void write(std::string const& out, std::string const& err,
+		   char const* outcome) override
+	{
+		std::lock_guard<std::mutex> guard(lock);
+		append_frame("out", out);
+		append_frame("err", err);
+		if (outcome != nullptr) {
+			if (strcmp(outcome, stats_outcome_name(OUTCOME_MODIFIED)) == 0) {
+				modified = true;
+				if (request.check)
+					stop.store(true, std::memory_order_relaxed);
+			} else if (strcmp(outcome, stats_outcome_name(OUTCOME_ERROR)) == 0) {
+				errors = true;
+			}
+		}
+		written++;
+		cond.notify_all();
+	}
+
+	void serve()
+	{
+		// Files are changed with the daemon's permissions, so only its
+		// own user and root may ask for that.
+		struct ucred cred;
+		socklen_t cred_size = sizeof(cred);
+		if (getsockopt(fd, SOL_SOCKET, SO_PEERCRED, &cred, &cred_size) != 0 ||
+		    (cred.uid != geteuid() && cred.uid != 0)) {
+			fail("Clients of other users are not served");
+			return;
+		}
+
+		std::string line;
+		if (!reader.next(line))
+			return;
+		if (line != DAEMON_PROTOCOL) {
+			fail("Unsupported protocol '" + line + "'");
+			return;
+		}
+		while (serve_request()) {
+		}
+	}
+
+private:
+	/* Serve the next request.  Returns false once the connection is done
+	   with.  */
+	bool serve_request()
+	{
+		request = daemon_request();
+		submitted = 0;
+		written = 0;
+		modified = false;
+		errors = false;
+		stop.store(false, std::memory_order_relaxed);
+		bool started = false;
+
+		std::string line;
+		while (reader.next(line)) {
+			if (line.starts_with("option ")) {
+				if (started) {
+					fail("Options must come before the files");
+					return false;
+				}
+				if (!parse_option(line.substr(7))) {
+					fail("Unknown option '" + line.substr(7) + "'");
+					return false;
+				}
+				continue;
+			}
+			if (line.starts_with("file ") || line.starts_with("fd ")) {
+				if (!started) {
+					opts = elfcleaner::make_options(request.api_level,
+									request.dry_run || request.check);
+					opts.stop_at_first_change = request.check;
+					started = true;
+				}
+				int passed = -1;
+				if (line.starts_with("fd ")) {
+					passed = reader.take_fd();
+					if (passed < 0) {
+						fail("No descriptor was passed for '" + line + "'");
+						return false;
+					}
+					// It is reopened for writing as the daemon, which a
+					// client that may only read the file must not get.
+					int const flags = fcntl(passed, F_GETFL);
+					if (flags < 0 || (flags & O_ACCMODE) != O_RDWR) {
+						close(passed);
+						fail("Descriptor for '" + line.substr(3) +
+						     "' is not open for reading and writing");
+						return false;
+					}
+				}
+				submit(line.substr(line.find(' ') + 1), passed);
+				drain(false);
+				continue;
+			}
+			if (line == "run") {
+				drain(true);
+				int status = 0;
+				if (request.check)
+					status = modified ? 1 : errors ? 2 : 0;
+				send_frames("exit " + std::to_string(status) + "\n");
+				return !broken;
+			}
+			fail("Bad request line '" + line + "'");
+			return false;
+		}
+		// The client went away; its files still have to finish.
+		drain(true);
+		return false;
+	}
+
+	bool parse_option(std::string const& option)
+	{
+		if (option.starts_with("cwd ")) {
+			request.cwd = option.substr(4);
+		} else if (option.starts_with("api-level ")) {
+			request.api_level = atoi(option.c_str() + 10);
+			if (request.api_level <= 0)
+				request.api_level = 21;
+		} else if (option == "dry-run") {
+			request.dry_run = true;
+		} else if (option == "check") {
+			request.check = true;
+		} else if (option == "log-format json") {
+			request.json = true;
+		} else if (option == "log-format text") {
+			request.json = false;
+		} else {
+			return false;
+		}
+		return true;
+	}
+
+	void submit(std::string name, int passed)
+	{
+		std::string path;
+		if (passed < 0 && name[0] != '/' && !request.cwd.empty())
+			path = request.cwd + "/" + name;
+		else
+			path = name;
+		uint64_t const seq = log_reserve(this);
+		submitted++;
+		pool.submit([this, name = std::move(name), path = std::move(path), passed, seq]() {
+			// As with --check locally, files queued after the first
+			// that needs changes are left alone.
+			if (stop.load(std::memory_order_relaxed)) {
+				log_begin(seq, name.c_str(), this);
+				log_end();
+			} else {
+				clean_client_file(name.c_str(), path.c_str(), passed, opts,
+						  seq, this);
+			}
+			// The record was written in log_end(), after which this
+			// session may be gone.
+			if (passed >= 0)
+				close(passed);
+		});
+	}
+
+	/* Send the records written so far and, if all, wait until the
+	   records of every submitted file have been sent.  */
+	void drain(bool all)
+	{
+		std::unique_lock<std::mutex> guard(lock);
+		while (true) {
+			if (!pending.empty()) {
+				std::string frames;
+				frames.swap(pending);
+				guard.unlock();
+				send_frames(frames);
+				guard.lock();
+			} else if (all && written < submitted) {
+				cond.wait(guard);
+			} else {
+				return;
+			}
+		}
+	}
+
+	/* Report a bad request to the client, after the files it did send
+	   are done.  */
+	void fail(std::string const& message)
+	{
+		drain(true);
+		std::string frames;
+		append_frame(frames, "err", std::string(PACKAGE_NAME) + ": " + message + "\n");
+		frames += "exit 1\n";
+		send_frames(frames);
+	}
+
+	void append_frame(char const* kind, std::string const& data)
+	{
+		append_frame(pending, kind, data);
+	}
+
+	static void append_frame(std::string& frames, char const* kind,
+				 std::string const& data)
+	{
+		if (data.empty())
+			return;
+		frames += kind;
+		frames += ' ';
+		frames += std::to_string(data.size());
+		frames += '\n';
+		frames += data;
+	}
+
+	void send_frames(std::string const& frames)
+	{
+		if (!broken && !send_all(fd, frames.data(), frames.size()))
+			broken = true;
+	}
+
+	int fd;
+	worker_pool& pool;
+	line_reader reader;
+	bool broken = false;
+
+	daemon_request request;
+	elfcleaner::options opts;
+	size_t submitted = 0;
+	std::atomic<bool> stop{false};
+
+	std::mutex lock;
+	std::condition_variable cond;
+	std::string pending;
+	size_t written = 0;
+	bool modified = false;
+	bool errors = false;
+};
+
+bool make_address(char const* path, struct sockaddr_un& addr)
+{
+	memset(&addr, 0, sizeof(addr));
+	addr.sun_family = AF_UNIX;
+	if (strlen(path) >= sizeof(addr.sun_path)) {
+		fprintf(stderr, "%s: Socket path '%s' is too long\n", PACKAGE_NAME, path);
+		return false;
+	}
+	strcpy(addr.sun_path, path);
+	return true;
+}
+
+/* Bind fd to addr, replacing a socket left behind by a daemon that is
+   gone, but not one that is still listening.  */
+bool bind_socket(int fd, struct sockaddr_un const& addr)
+{
+	if (bind(fd, (struct sockaddr const*) &addr, sizeof(addr)) == 0)
+		return true;
+	if (errno != EADDRINUSE) {
+		perror_path("bind", addr.sun_path);
+		return false;
+	}
+
+	int const probe = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+	bool const live = probe >= 0 &&
+		connect(probe, (struct sockaddr const*) &addr, sizeof(addr)) == 0;
+	if (probe >= 0)
+		close(probe);
+	if (live) {
+		fprintf(stderr, "%s: A daemon is already listening on '%s'\n",
+			PACKAGE_NAME, addr.sun_path);
+		return false;
+	}
+	unlink(addr.sun_path);
+	if (bind(fd, (struct sockaddr const*) &addr, sizeof(addr)) != 0) {
+		perror_path("bind", addr.sun_path);
+		return false;
+	}
+	return true;
+}
+
+/* Connections being served, so shutting down can end them.  */
+std::mutex sessions_lock;
+std::condition_variable sessions_cond;
+std::set<int> session_fds;
+
+}
+
+int run_daemon(char const* path, worker_pool& pool)
+{
+	struct sockaddr_un addr;
+	if (!make_address(path, addr))
+		return 1;
+
+	int const listen_fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+	if (listen_fd < 0) {
+		log_perror("socket()");
+		return 1;
+	}
+	if (!bind_socket(listen_fd, addr)) {
+		close(listen_fd);
+		return 1;
+	}
+	int const stop_fd = stop_signal_fd();
+	if (listen(listen_fd, SOMAXCONN) != 0 || stop_fd < 0) {
+		if (stop_fd >= 0)
+			log_perror("listen()");
+		close(listen_fd);
+		unlink(path);
+		return 1;
+	}
+	signal(SIGPIPE, SIG_IGN);
+
+	struct pollfd fds[2] = {
+		{listen_fd, POLLIN, 0},
+		{stop_fd, POLLIN, 0},
+	};
+	while (true) {
+		if (poll(fds, 2, -1) < 0) {
+			if (errno == EINTR)
+				continue;
+			log_perror("poll()");
+			break;
+		}
+		if (fds[1].revents != 0)
+			break;
+		if (fds[0].revents == 0)
+			continue;
+
+		int const fd = accept4(listen_fd, NULL, NULL, SOCK_CLOEXEC);
+		if (fd < 0) {
+			if (errno != EINTR && errno != ECONNABORTED && errno != EAGAIN)
+				log_perror("accept()");
+			continue;
+		}
+		std::lock_guard<std::mutex> guard(sessions_lock);
+		session_fds.insert(fd);
+		std::thread([fd, &pool]() {
+			session(fd, pool).serve();
+			std::lock_guard<std::mutex> guard(sessions_lock);
+			close(fd);
+			session_fds.erase(fd);
+			sessions_cond.notify_all();
+		}).detach();
+	}
+
+	close(listen_fd);
+	unlink(path);
+
+	// Let every connection finish the request it is on, and no more.
+	std::unique_lock<std::mutex> guard(sessions_lock);
+	for (int fd : session_fds)
+		shutdown(fd, SHUT_RD);
+	sessions_cond.wait(guard, []() { return session_fds.empty(); });
+	return 0;
+}
+
+int run_client(char const* path, daemon_request const& req)
+{
+	struct sockaddr_un addr;
+	if (!make_address(path, addr))
+		return -1;
+
+	// Names with newlines cannot be sent; leave them to a local run.
+	if (req.cwd.find('\n') != std::string::npos)
+		return -1;
+	std::string request = DAEMON_PROTOCOL "\n";
+	if (!req.cwd.empty())
+		request += "option cwd " + req.cwd + "\n";
+	if (req.api_level != 21)
+		request += "option api-level " + std::to_string(req.api_level) + "\n";
+	if (req.dry_run)
+		request += "option dry-run\n";
+	if (req.check)
+		request += "option check\n";
+	if (req.json)
+		request += "option log-format json\n";
+	for (std::string const& file : req.files) {
+		if (file.empty() || file.find('\n') != std::string::npos)
+			return -1;
+		request += "file " + file + "\n";
+	}
+	request += "run\n";
+
+	int const fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC | SOCK_NONBLOCK, 0);
+	if (fd < 0)
+		return -1;
+	if (connect(fd, (struct sockaddr const*) &addr, sizeof(addr)) != 0) {
+		close(fd);
+		return -1;
+	}
+
+	// Send and receive at once, as the daemon answers while it is
+	// still reading.
+	size_t sent = 0;
+	std::string received;
+	int status = -1;
+	while (status < 0) {
+		struct pollfd pfd = {fd, POLLIN, 0};
+		if (sent < request.size())
+			pfd.events |= POLLOUT;
+		if (poll(&pfd, 1, -1) < 0) {
+			if (errno == EINTR)
+				continue;
+			break;
+		}
+		if (pfd.revents & POLLOUT) {
+			ssize_t const n = send(fd, request.data() + sent, request.size() - sent,
+					       MSG_NOSIGNAL);
+			if (n < 0 && errno != EAGAIN && errno != EINTR)
+				break;
+			if (n > 0)
+				sent += n;
+		}
+		if (!(pfd.revents & (POLLIN | POLLHUP | POLLERR)))
+			continue;
+
+		char buffer[65536];
+		ssize_t const n = recv(fd, buffer, sizeof(buffer), 0);
+		if (n < 0 && (errno == EAGAIN || errno == EINTR))
+			continue;
+		if (n <= 0)
+			break;
+		received.append(buffer, n);
+
+		// Print every complete frame.
+		size_t start = 0;
+		while (status < 0) {
+			size_t const end = received.find('\n', start);
+			if (end == std::string::npos)
+				break;
+			std::string const header = received.substr(start, end - start);
+			if (header.starts_with("exit ")) {
+				status = atoi(header.c_str() + 5);
+				start = end + 1;
+				break;
+			}
+			bool const out = header.starts_with("out ");
+			if (!out && !header.starts_with("err ")) {
+				status = 2;
+				break;
+			}
+			size_t const length = strtoull(header.c_str() + 4, NULL, 10);
+			if (received.size() - (end + 1) < length)
+				break;
+			char const* data = received.data() + end + 1;
+			start = end + 1 + length;
+			if (out) {
+				// The daemon leaves --quiet to the client.
+				if (quiet && (!req.json || std::string_view(data, length)
+					      .find("\"errors\": []") != std::string_view::npos))
+					continue;
+				fwrite(data, 1, length, stdout);
+			} else {
+				fflush(stdout);
+				fwrite(data, 1, length, stderr);
+			}
+		}
+		received.erase(0, start);
+	}
+	close(fd);
+
+	if (status < 0) {
+		fprintf(stderr, "%s: Lost the connection to the daemon at '%s'\n",
+			PACKAGE_NAME, path);
+		return 2;
+	}
+	return status;
+}
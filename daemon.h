@@ -0,0 +1,71 @@
+/* termux-elf-cleaner
+
+Copyright (C) 2026 Termux
+
+This file is part of termux-elf-cleaner.
+
+termux-elf-cleaner is free software: you can redistribute it and/or
+modify it under the terms of the GNU General Public License as
+published by the Free Software Foundation, either version 3 of the
+License, or (at your option) any later version.
+
+termux-elf-cleaner is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with termux-elf-cleaner.  If not, see
+<https://www.gnu.org/licenses/>.  */
+
+#ifndef ELF_CLEANER_DAEMON_H
+#define ELF_CLEANER_DAEMON_H
+
+#include <string>
+#include <vector>
+
+class worker_pool;
+
+/* First line of every connection, naming the protocol version.  */
+#define DAEMON_PROTOCOL "termux-elf-cleaner 1"
+
+/* A request a client sends to the daemon: the options of one run and
+   its files, with relative names taken from cwd.  */
+struct daemon_request {
+	std::string cwd;
+	int api_level = 21;
+	bool dry_run = false;
+	bool check = false;
+	bool json = false;
+	std::vector<std::string> files;
+};
+
+/* Listen on the Unix socket at path and clean the files that clients
+   send on pool, until SIGINT or SIGTERM.  Returns 0 after shutting down
+   and 1 if the socket could not be set up.
+
+   A client sends DAEMON_PROTOCOL and then requests, each made of lines
+
+       option cwd DIR
+       option api-level N
+       option dry-run
+       option check
+       option log-format json
+       file PATH
+       fd NAME
+       run
+
+   where relative file names are taken from DIR, and each fd line takes
+   the next descriptor passed with SCM_RIGHTS, which must be open for
+   reading and writing, and names it NAME in messages.  Only clients of
+   the daemon's own user and root are served.  The daemon answers every request
+   with "out LENGTH" and "err LENGTH" lines, each followed by that many
+   bytes for stdout or stderr, and a final "exit STATUS" line.  */
+int run_daemon(char const* path, worker_pool& pool);
+
+/* Send req to the daemon at path, print what it answers, honouring
+   quiet, and return the exit status it sends.  Returns -1 if no daemon
+   could be reached, before anything was sent.  */
+int run_client(char const* path, daemon_request const& req);
+
+#endif
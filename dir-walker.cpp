@@ -0,0 +1,182 @@
+/* termux-elf-cleaner
+
+Copyright (C) 2026 Termux
+
+This file is part of termux-elf-cleaner.
+
+termux-elf-cleaner is free software: you can redistribute it and/or
+modify it under the terms of the GNU General Public License as
+published by the Free Software Foundation, either version 3 of the
+License, or (at your option) any later version.
+
+termux-elf-cleaner is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with termux-elf-cleaner.  If not, see
+<https://www.gnu.org/licenses/>.  */
+
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE
+#endif
+
+#include <dirent.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <fnmatch.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include <atomic>
+#include <memory>
+
+#include "dir-walker.h"
+#include "elf-cleaner.h"
+
+/* Directories queued as separate tasks each keep their descriptor open,
+   so past this many the walk continues depth first in the current task
+   instead.  */
+#define MAX_QUEUED_DIRS 256
+
+#define DIRENT_BUFFER_SIZE (32 * 1024)
+
+/* Layout of the records returned by getdents64(2).  */
+struct linux_dirent64 {
+	uint64_t d_ino;
+	int64_t d_off;
+	unsigned short d_reclen;
+	unsigned char d_type;
+	char d_name[];
+};
+
+struct walk_state {
+	worker_pool& pool;
+	walk_filter filter;
+	std::function<void(std::string const&)> on_file;
+	std::atomic<bool> const* stop;
+	std::atomic<int> queued_dirs{0};
+
+	walk_state(worker_pool& pool, walk_filter const& filter,
+		   std::function<void(std::string const&)> on_file,
+		   std::atomic<bool> const* stop)
+		: pool(pool), filter(filter), on_file(std::move(on_file)), stop(stop) {}
+
+	bool stopped() const { return stop != nullptr && stop->load(std::memory_order_relaxed); }
+};
+
+static bool matches_any(std::vector<std::string> const& patterns, char const* name)
+{
+	for (auto const& pattern : patterns)
+		if (fnmatch(pattern.c_str(), name, 0) == 0)
+			return true;
+	return false;
+}
+
+bool walk_filter::accepts_file(char const* name) const
+{
+	if (!include.empty() && !matches_any(include, name))
+		return false;
+	return !matches_any(exclude, name);
+}
+
+bool walk_filter::accepts_dir(char const* name) const
+{
+	return !matches_any(exclude, name);
+}
+
+static void walk_dir(std::shared_ptr<walk_state> const& state, int dir_fd,
+		     std::string const& path)
+{
+	std::unique_ptr<char[]> buffer(new char[DIRENT_BUFFER_SIZE]);
+
+	while (!state->stopped()) {
+		long n = syscall(SYS_getdents64, dir_fd, buffer.get(), DIRENT_BUFFER_SIZE);
+		if (n < 0) {
+			perror_path("getdents64", path.c_str());
+			break;
+		}
+		if (n == 0)
+			break;
+
+		for (long pos = 0; pos < n;) {
+			auto* entry = reinterpret_cast<linux_dirent64*>(buffer.get() + pos);
+			pos += entry->d_reclen;
+
+			char const* name = entry->d_name;
+			if (name[0] == '.' && (name[1] == 0 || (name[1] == '.' && name[2] == 0)))
+				continue;
+
+			unsigned char type = entry->d_type;
+			if (type == DT_UNKNOWN) {
+				struct stat st;
+				if (fstatat(dir_fd, name, &st, AT_SYMLINK_NOFOLLOW) < 0) {
+					perror_path("fstatat", (path + "/" + name).c_str());
+					continue;
+				}
+				if (S_ISDIR(st.st_mode))
+					type = DT_DIR;
+				else if (S_ISREG(st.st_mode))
+					type = DT_REG;
+			}
+
+			if (type == DT_REG) {
+				if (state->filter.accepts_file(name))
+					state->on_file(path + "/" + name);
+			} else if (type == DT_DIR) {
+				if (!state->filter.accepts_dir(name))
+					continue;
+				std::string child_path = path + "/" + name;
+				int child_fd = openat(dir_fd, name,
+						      O_RDONLY | O_DIRECTORY | O_NOFOLLOW | O_CLOEXEC);
+				if (child_fd < 0) {
+					perror_path("openat", child_path.c_str());
+					continue;
+				}
+				if (state->queued_dirs.fetch_add(1) < MAX_QUEUED_DIRS) {
+					state->pool.submit([state, child_fd, child_path]() {
+						walk_dir(state, child_fd, child_path);
+						state->queued_dirs.fetch_sub(1);
+					});
+				} else {
+					state->queued_dirs.fetch_sub(1);
+					walk_dir(state, child_fd, child_path);
+				}
+			}
+		}
+	}
+
+	if (close(dir_fd) != 0)
+		perror_path("close", path.c_str());
+}
+
+void walk_tree(worker_pool& pool, std::string const& root,
+	       walk_filter const& filter,
+	       std::function<void(std::string const& path)> on_file,
+	       std::atomic<bool> const* stop)
+{
+	int fd = open(root.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+	if (fd < 0) {
+		// Files named on the command line are processed unfiltered.
+		if (errno == ENOTDIR)
+			on_file(root);
+		else
+			perror_path("open", root.c_str());
+		return;
+	}
+
+	std::string path = root;
+	while (path.size() > 1 && path.back() == '/')
+		path.pop_back();
+
+	auto state = std::make_shared<walk_state>(pool, filter, std::move(on_file), stop);
+	state->queued_dirs.fetch_add(1);
+	pool.submit([state, fd, path]() {
+		walk_dir(state, fd, path == "/" ? std::string() : path);
+		state->queued_dirs.fetch_sub(1);
+	});
+}
@@ -0,0 +1,53 @@
+/* termux-elf-cleaner
+
+Copyright (C) 2026 Termux
+
+This file is part of termux-elf-cleaner.
+
+termux-elf-cleaner is free software: you can redistribute it and/or
+modify it under the terms of the GNU General Public License as
+published by the Free Software Foundation, either version 3 of the
+License, or (at your option) any later version.
+
+termux-elf-cleaner is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with termux-elf-cleaner.  If not, see
+<https://www.gnu.org/licenses/>.  */
+
+#ifndef ELF_CLEANER_DIR_WALKER_H
+#define ELF_CLEANER_DIR_WALKER_H
+
+#include <atomic>
+#include <functional>
+#include <string>
+#include <vector>
+
+#include "worker-pool.h"
+
+/* Glob filters on file names, checked before anything is opened.
+   Patterns are matched against the last path component with
+   fnmatch().  Excluded directories are not descended into.  */
+struct walk_filter {
+	std::vector<std::string> include;
+	std::vector<std::string> exclude;
+
+	bool accepts_file(char const* name) const;
+	bool accepts_dir(char const* name) const;
+};
+
+/* Walk the tree below root in parallel on pool and call on_file for
+   every regular file accepted by filter, from the thread that found it;
+   on_file is expected to submit the file's work to pool.  Symbolic links
+   are not followed.  The walk ends early once *stop, if given, is set.
+   Returns without waiting for the walk to finish; use pool.wait() for
+   that.  */
+void walk_tree(worker_pool& pool, std::string const& root,
+	       walk_filter const& filter,
+	       std::function<void(std::string const& path)> on_file,
+	       std::atomic<bool> const* stop = nullptr);
+
+#endif
@@ -23,34 +23,119 @@ along with termux-elf-cleaner.  If not, see
 #define _GNU_SOURCE
 #endif
 
+#include <errno.h>
 #include <fcntl.h>
 #include <getopt.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <sys/mman.h>
+#include <sys/resource.h>
 #include <sys/stat.h>
+#include <sys/sysmacros.h>
 #include <sys/types.h>
 #include <unistd.h>
 
 #include <algorithm>
-#include <future>
-#include <semaphore>
+#include <atomic>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <span>
+#include <string>
 #include <thread>
 #include <vector>
 
 // Include a local elf.h copy as not all platforms have it.
 #include "elf.h"
+#include "elf-cleaner.h"
+#include "elfcleaner.h"
+#include "ar-archive.h"
+#include "daemon.h"
+#include "dir-walker.h"
+#include "file-log.h"
+#include "inode-set.h"
+#include "io-engine.h"
+#include "output-copy.h"
+#include "page-cache.h"
+#include "patch-manifest.h"
+#include "skip-cache.h"
+#include "stats.h"
+#include "tar-filter.h"
+#include "uring.h"
+#include "watcher.h"
+#include "worker-pool.h"
+#include "zip-archive.h"
 
 /* Taken from emacs */
 #define ARRAYELTS(arr) (sizeof (arr) / sizeof (arr)[0])
 
-/* Default to api level 21 unless arg --api-level given  */
-uint8_t supported_dt_flags_1 = (DF_1_NOW | DF_1_GLOBAL);
-int api_level = 21;
+/* How many files may wait in the work queues per job before the
+   submitting thread blocks.  */
+#define PENDING_FILES_PER_JOB 16
+
+/* With --io-engine uring, files are handed to the workers in batches of
+   this many, and each step of opening, stat()ing, reading and closing
+   them is a single round on the worker's ring.  */
+#define URING_BATCH_FILES 32
+
+/* Operations in a round: a stat and a read per file.  */
+#define URING_ENTRIES (2 * URING_BATCH_FILES)
+
+/* With --order=largest, files given as arguments are started largest
+   first within windows of this many.  */
+#define ORDER_WINDOW_FILES 4096
+
+/* Names read with --files-from are only reordered when --order=largest
+   is given, and then within windows this small, so that cleaning keeps
+   up with the list as it is written.  */
+#define ORDER_LIST_WINDOW_FILES 64
+
+/* Reserved positions held back in a window and a batch must not make
+   log_reserve() wait for themselves.  */
+static_assert(ORDER_WINDOW_FILES + URING_BATCH_FILES < LOG_ORDER_WINDOW);
 
 int dry_run = 0;
 int quiet = 0;
+int recursive = 0;
+int null_separated = 0;
+int io_engine = IO_ENGINE_MMAP;
+int cache_xattr = 0;
+int stats_format = STATS_FORMAT_NONE;
+int log_format = LOG_FORMAT_TEXT;
+int check = 0;
+int tar_filter = 0;
+int sync_policy = SYNC_FILE;
+int page_cache_policy = PAGE_CACHE_NORMAL;
+int file_order = FILE_ORDER_LARGEST;
+
+static std::unique_ptr<skip_cache> cache;
+
+/* Whether --order=largest was given, which also reorders listed names.  */
+static int order_listed = 0;
+
+/* Where cleaned files go instead of over themselves, if given.  */
+static char const* output_dir = NULL;
+static char const* output_suffix = NULL;
+
+/* For --emit-patch: the changes recorded instead of written.  */
+static char const* emit_patch = NULL;
+static std::mutex emitted_lock;
+static std::vector<file_patch> emitted_patches;
+
+/* The ELF files and archives seen so far, in runs over a fixed set of
+   files, where a second visit to one can only be another name for it.  */
+static inode_set* seen_files = nullptr;
+
+/* The pool the files are processed on, which archive members are spread
+   over as well.  */
+static worker_pool* file_pool = nullptr;
+
+/* For --check: whether a file needing changes or an error was seen.
+   Once the first is set, the answer is known and the rest is skipped.  */
+static std::atomic<bool> needs_changes{false};
+static std::atomic<bool> had_errors{false};
 
 static char const *const usage_message[] =
 { "\
@@ -62,251 +147,1296 @@ Options:\n\
 \n\
 --api-level NN        choose target api level, i.e. 21, 24, ..\n\
 --jobs N              run parallel on n thread(s).\n\
+--recursive           process regular files in the given directories\n\
+                      and all their subdirectories\n\
+--include GLOB        with --recursive, only process files whose name\n\
+                      matches GLOB (may be repeated)\n\
+--exclude GLOB        with --recursive, skip files and directories whose\n\
+                      name matches GLOB (may be repeated)\n\
+--watch DIR           clean the files written to the tree below DIR, as\n\
+                      they are closed, until interrupted\n\
+--files-from FILE     also process the files listed in FILE, one per\n\
+                      line, or read the list from stdin if FILE is -\n\
+-0, --null            names in the --files-from list end with a NUL\n\
+                      character instead of a newline\n\
+--tar-filter          clean the ELF files in a tar stream read from stdin\n\
+                      and write the stream to stdout\n\
+--daemon SOCKET       keep running and clean the files that clients send\n\
+                      on the Unix socket SOCKET, until interrupted\n\
+--client SOCKET       have the daemon on SOCKET clean the files, and\n\
+                      clean them here if there is none\n\
+--output-dir DIR      write cleaned files below DIR, under the names\n\
+                      they were given by, and leave the originals alone\n\
+--suffix SUFFIX       write cleaned files next to the originals, with\n\
+                      SUFFIX appended to their names\n\
+--emit-patch FILE     record the changes to make in the patch manifest\n\
+                      FILE instead of making them\n\
+--apply-patch FILE    make the changes recorded in the patch manifest\n\
+                      FILE, to the files it names, without looking at\n\
+                      anything else in them\n\
+--sync=POLICY         when written files are synced: file (the default)\n\
+                      syncs each file after writing it, batch syncs each\n\
+                      file system once at the end and none leaves it to\n\
+                      the system\n\
+--page-cache=POLICY   how files are read into the page cache: normal (the\n\
+                      default) leaves it to the system, sparse reads only\n\
+                      the parts of files that are looked at and drops\n\
+                      what was not cached before once done with a file\n\
+--order=ORDER         in which order files given as arguments are started:\n\
+                      largest (the default) starts the files expected to\n\
+                      take longest first, given starts them as given;\n\
+                      names from --files-from are only reordered, in\n\
+                      small windows, if largest is given explicitly;\n\
+                      messages come out in the order given either way\n\
 --dry-run             print info but but do not remove entries\n\
+--check               only check whether any file needs changes, without\n\
+                      writing anything; exit with 1 if one does, 2 if a\n\
+                      file could not be checked and 0 otherwise\n\
 --quiet               do not print info about removed entries\n\
+--cache FILE          remember files that need no changes in FILE and\n\
+                      skip them in later runs unless they change\n\
+--cache-xattr         like --cache, but remember it in an extended\n\
+                      attribute of every file\n\
+--io-engine ENGINE    how files are read: mmap (the default) maps whole\n\
+                      files, pread reads only the headers and dynamic\n\
+                      sections, uring reads like pread but opens, stat()s\n\
+                      and closes files in batches with io_uring\n\
+--stats[=json]        print time spent per phase, bytes, outcomes, rule\n\
+                      hits and a latency histogram to stderr at exit\n\
+--log-format FORMAT   text (the default) or json, which prints a JSON\n\
+                      object per file and line\n\
 --help                display this help and exit\n\
 --version             output version information and exit\n"
 };
 
-template<typename ElfWord /*Elf{32_Word,64_Xword}*/,
-	 typename ElfHeaderType /*Elf{32,64}_Ehdr*/,
-	 typename ElfSectionHeaderType /*Elf{32,64}_Shdr*/,
-	 typename ElfProgramHeaderType /*Elf{32,64}_Phdr*/,
-	 typename ElfDynamicSectionEntryType /* Elf{32,64}_Dyn */>
-bool process_elf(uint8_t* bytes, size_t elf_file_size, char const* file_name)
+void perror_path(const char *call, const char *path)
 {
-	if (sizeof(ElfSectionHeaderType) > elf_file_size) {
-		fprintf(stderr, "%s: Elf header for '%s' would end at %zu but file size only %zu\n",
-			PACKAGE_NAME, file_name, sizeof(ElfSectionHeaderType), elf_file_size);
-		return false;
+	int const saved_errno = errno;
+	log_error("%s(\"%s\"): %s", call, path, strerror(saved_errno));
+}
+
+/* Print the problem with the file, if any, and set outcome from res.
+   Returns 0 if the file was processed or skipped, 1 on error.  */
+static int report_status(elfcleaner::result const& res, const char *file_name,
+			 stats_outcome& outcome)
+{
+	using elfcleaner::status;
+
+	outcome = OUTCOME_ERROR;
+	switch (res.code) {
+	case status::ok:
+		// Also in a dry run, where the file is left as it is.
+		outcome = res.changes.empty() ? OUTCOME_CLEAN : OUTCOME_MODIFIED;
+		return 0;
+	case status::not_elf:
+		outcome = OUTCOME_NOT_ELF;
+		return 0;
+	case status::big_endian:
+		log_error("%s: Not little endianness in '%s'",
+			  PACKAGE_NAME, file_name);
+		outcome = OUTCOME_BIG_ENDIAN;
+		return 0;
+	case status::bad_class:
+		log_error("%s: Incorrect bit value %d in '%s'",
+			  PACKAGE_NAME, res.elf_class, file_name);
+		return 1;
+	case status::truncated:
+		log_error("%s: %s for '%s' would end at %zu but file size only %zu",
+			  PACKAGE_NAME, res.truncated_part, file_name,
+			  res.truncated_end, res.file_size);
+		return 1;
+	case status::read_error:
+		errno = res.error;
+		perror_path("read", file_name);
+		return 1;
 	}
-	ElfHeaderType* elf_hdr = reinterpret_cast<ElfHeaderType*>(bytes);
+	return 1;
+}
 
-	bool is_aarch64 = (elf_hdr->e_machine == 183); /* EM_AARCH64 */
+/* Count, print and report the changes and status in res.  */
+static int report_result(elfcleaner::result const& res, const char *file_name,
+			 elfcleaner::options const& opts, run_stats* stats,
+			 stats_outcome& outcome)
+{
+	if (stats != nullptr)
+		stats->add_changes(res);
+	if (quiet) {
+	} else if (opts.stop_at_first_change && !log_json()) {
+		// Only the first change was looked for.
+		if (!res.changes.empty())
+			log_info("%s: '%s' needs changes", PACKAGE_NAME, file_name);
+	} else {
+		log_changes(file_name, res);
+	}
+	return report_status(res, file_name, outcome);
+}
 
-	/* Check TLS segment alignment in program headers if api level is < 29 */
-	size_t last_program_header_byte = elf_hdr->e_phoff + sizeof(ElfProgramHeaderType) * elf_hdr->e_phnum;
-	if (last_program_header_byte > elf_file_size) {
-		fprintf(stderr, "%s: Program header for '%s' would end at %zu but file size only %zu\n",
-			PACKAGE_NAME, file_name, last_program_header_byte, elf_file_size);
-		return false;
+/* Clean image and print what was changed.  Returns 0 if the file was
+   processed or skipped, 1 on error, and sets outcome unless modified
+   is to decide between clean and modified.  */
+static int process_image(elfcleaner::image& image, const char *file_name,
+			 elfcleaner::options const& opts, run_stats* stats,
+			 stats_outcome& outcome)
+{
+	using namespace elfcleaner;
+
+	struct rusage usage_before;
+	if (stats != nullptr)
+		getrusage(RUSAGE_THREAD, &usage_before);
+	result const res = clean(image, opts);
+	if (stats != nullptr) {
+		struct rusage usage_after;
+		getrusage(RUSAGE_THREAD, &usage_after);
+		stats->minor_faults += usage_after.ru_minflt - usage_before.ru_minflt;
+		stats->major_faults += usage_after.ru_majflt - usage_before.ru_majflt;
+	}
+	return report_result(res, file_name, opts, stats, outcome);
+}
+
+/* The ring of the calling worker for --io-engine uring, set up on first
+   use, or nullptr if io_uring cannot be used on this thread.  */
+static uring* thread_ring()
+{
+	thread_local std::unique_ptr<uring> ring;
+	thread_local bool unavailable = false;
+	if (!ring && !unavailable) {
+		ring = std::make_unique<uring>();
+		if (!ring->init(URING_ENTRIES)) {
+			ring.reset();
+			unavailable = true;
+		}
+	}
+	return ring.get();
+}
+
+/* For --sync=batch: a descriptor on each file system written to, for
+   syncfs() at the end of the run.  */
+static std::mutex batch_sync_lock;
+static std::map<dev_t, int> batch_sync_fds;
+
+/* For --sync=batch: remember the file system of fd, which was written
+   to.  */
+static void sync_later(int fd)
+{
+	if (sync_policy != SYNC_BATCH)
+		return;
+	struct stat st;
+	if (fstat(fd, &st) < 0) {
+		log_perror("fstat()");
+		return;
 	}
-	ElfProgramHeaderType* program_header_table = reinterpret_cast<ElfProgramHeaderType*>(bytes + elf_hdr->e_phoff);
-
-	size_t tls_min_alignment = sizeof(ElfWord)*8;
-	/* Iterate over program headers */
-	for (unsigned int i = 1; i < elf_hdr->e_phnum; i++) {
-		ElfProgramHeaderType* program_header_entry = program_header_table + i;
-		if (program_header_entry->p_type == PT_TLS &&
-		    program_header_entry->p_align < tls_min_alignment) {
-			if (!quiet)
-				printf("%s: Changing TLS alignment for '%s' to %u, instead of %u\n",
-				       PACKAGE_NAME, file_name,
-				       (unsigned int)tls_min_alignment,
-				       (unsigned int)program_header_entry->p_align);
-			if (!dry_run)
-				program_header_entry->p_align = tls_min_alignment;
+	std::lock_guard<std::mutex> guard(batch_sync_lock);
+	if (batch_sync_fds.count(st.st_dev) != 0)
+		return;
+	int const sync_fd = fcntl(fd, F_DUPFD_CLOEXEC, 0);
+	if (sync_fd < 0)
+		log_perror("fcntl()");
+	else
+		batch_sync_fds[st.st_dev] = sync_fd;
+}
+
+/* For --sync=batch: sync every file system written to.  Returns false
+   after an error.  */
+static bool sync_filesystems()
+{
+	run_stats* stats = thread_stats();
+	uint64_t const time = stats ? stats_clock() : 0;
+	bool ok = true;
+	std::lock_guard<std::mutex> guard(batch_sync_lock);
+	for (auto const& [dev, fd] : batch_sync_fds) {
+		if (syncfs(fd) != 0) {
+			log_perror("syncfs()");
+			ok = false;
 		}
+		close(fd);
+	}
+	batch_sync_fds.clear();
+	stats_lap(stats, PHASE_SYNC, time);
+	return ok;
+}
+
+/* Write the changes made to images to fd and, if sync, sync it as a
+   single round on ring: the writes linked, so that the fdatasync() only
+   runs if all of them succeeded.  Returns 1 if done, 0 if there are more
+   changes than fit in a round, and with errno set -1 if writing and -2
+   if syncing failed.  */
+static int commit_with_ring(uring& ring, int fd, std::span<elfcleaner::image* const> images,
+			    bool sync, size_t& written)
+{
+	std::vector<elfcleaner::image::range> ranges;
+	for (auto* image : images)
+		for (auto const& range : image->modified_ranges())
+			ranges.push_back(range);
+	if (ranges.size() + sync > URING_ENTRIES)
+		return 0;
+
+	for (auto const& range : ranges) {
+		io_uring_sqe* sqe = ring.next_sqe();
+		if (sqe == nullptr)
+			return 0;
+		sqe->opcode = IORING_OP_WRITE;
+		sqe->flags = sync ? IOSQE_IO_LINK : 0;
+		sqe->fd = fd;
+		sqe->addr = reinterpret_cast<uint64_t>(range.data);
+		sqe->len = range.length;
+		sqe->off = range.offset;
+		sqe->user_data = &range - ranges.data();
+	}
+	if (sync) {
+		io_uring_sqe* sqe = ring.next_sqe();
+		if (sqe == nullptr)
+			return 0;
+		sqe->opcode = IORING_OP_FSYNC;
+		sqe->fd = fd;
+		sqe->fsync_flags = IORING_FSYNC_DATASYNC;
+		sqe->user_data = ranges.size();
+	}
+
+	// A short write cancels the rest of the chain, like an error.
+	int write_error = 0;
+	int sync_error = 0;
+	bool const ran = ring.run([&](uint64_t i, int32_t res) {
+		if (i == ranges.size())
+			sync_error = res < 0 ? -res : 0;
+		else if (res < 0 && write_error == 0)
+			write_error = -res;
+		else if (res >= 0 && (size_t) res < ranges[i].length && write_error == 0)
+			write_error = EIO;
+	});
+	if (!ran)
+		return -1;
+	if (write_error != 0) {
+		errno = write_error;
+		return -1;
 	}
+	if (sync_error != 0) {
+		errno = sync_error;
+		return -2;
+	}
+	for (auto const& range : ranges)
+		written += range.length;
+	return 1;
+}
 
-	size_t last_section_header_byte = elf_hdr->e_shoff + sizeof(ElfSectionHeaderType) * elf_hdr->e_shnum;
-	if (last_section_header_byte > elf_file_size) {
-		fprintf(stderr, "%s: Section header for '%s' would end at %zu but file size only %zu\n",
-			PACKAGE_NAME, file_name, last_section_header_byte, elf_file_size);
+/* Whether the file open as fd is still the one described by st, which
+   the changes were made to.  */
+static bool unchanged_since(int fd, struct stat const& st, const char *file_name)
+{
+	struct stat now_st;
+	if (fstat(fd, &now_st) < 0) {
+		log_perror("fstat()");
 		return false;
 	}
-	ElfSectionHeaderType* section_header_table = reinterpret_cast<ElfSectionHeaderType*>(bytes + elf_hdr->e_shoff);
-
-	/* Iterate over section headers */
-	for (unsigned int i = 1; i < elf_hdr->e_shnum; i++) {
-		ElfSectionHeaderType* section_header_entry = section_header_table + i;
-		if (section_header_entry->sh_type == SHT_DYNAMIC) {
-			size_t const last_dynamic_section_byte = section_header_entry->sh_offset + section_header_entry->sh_size;
-			if (last_dynamic_section_byte > elf_file_size) {
-				fprintf(stderr, "%s: Dynamic section for '%s' would end at %zu but file size only %zu\n",
-					PACKAGE_NAME, file_name, last_dynamic_section_byte, elf_file_size);
-				return false;
-			}
+	if (now_st.st_dev != st.st_dev || now_st.st_ino != st.st_ino ||
+	    now_st.st_size != st.st_size ||
+	    now_st.st_mtim.tv_sec != st.st_mtim.tv_sec ||
+	    now_st.st_mtim.tv_nsec != st.st_mtim.tv_nsec) {
+		log_error("%s: '%s' changed while it was being processed",
+			  PACKAGE_NAME, file_name);
+		return false;
+	}
+	return true;
+}
 
-			size_t const dynamic_section_entries = section_header_entry->sh_size / sizeof(ElfDynamicSectionEntryType);
-			ElfDynamicSectionEntryType* const dynamic_section =
-				reinterpret_cast<ElfDynamicSectionEntryType*>(bytes + section_header_entry->sh_offset);
+/* For --output-dir and --suffix: reopen file_name, by open_name, and
+   start its cleaned copy in copy.  Returns the descriptor of the copy,
+   or -1 after logging an error.  */
+static int start_copy(const char *file_name, const char *open_name,
+		      struct stat const& st, output_copy& copy, run_stats* stats)
+{
+	if (!output_copy_path(file_name, output_dir, output_suffix, copy.path))
+		return -1;
+	int const in_fd = open(open_name, O_RDONLY);
+	if (in_fd < 0) {
+		perror_path("open", file_name);
+		return -1;
+	}
+	uint64_t copied = 0;
+	bool const ok = unchanged_since(in_fd, st, file_name) &&
+		create_output_copy(in_fd, st.st_size, st.st_mode, copy, copied);
+	close(in_fd);
+	if (stats != nullptr)
+		stats->bytes_written += copied;
+	return ok ? copy.fd : -1;
+}
 
-			unsigned int last_nonnull_entry_idx = 0;
-			for (unsigned int j = dynamic_section_entries - 1; j > 0; j--) {
-				ElfDynamicSectionEntryType* dynamic_section_entry = dynamic_section + j;
-				if (dynamic_section_entry->d_tag != DT_NULL) {
-					last_nonnull_entry_idx = j;
-					break;
-				}
-			}
-			for (unsigned int j = 0; j < dynamic_section_entries; j++) {
-				ElfDynamicSectionEntryType* dynamic_section_entry = dynamic_section + j;
-
-				char const* removed_name = nullptr;
-				switch (dynamic_section_entry->d_tag) {
-					case DT_GNU_HASH: if (api_level < 23) removed_name = "DT_GNU_HASH"; break;
-					case DT_VERSYM: if (api_level < 23) removed_name = "DT_VERSYM"; break;
-					case DT_VERNEED: if (api_level < 23) removed_name = "DT_VERNEED"; break;
-					case DT_VERNEEDNUM: if (api_level < 23) removed_name = "DT_VERNEEDNUM"; break;
-					case DT_VERDEF: if (api_level < 23) removed_name = "DT_VERDEF"; break;
-					case DT_VERDEFNUM: if (api_level < 23) removed_name = "DT_VERDEFNUM"; break;
-					case DT_RPATH: removed_name = "DT_RPATH"; break;
-					case DT_RUNPATH: if (api_level < 24) removed_name = "DT_RUNPATH"; break;
-					case DT_AARCH64_BTI_PLT: if (is_aarch64 && api_level < 31) removed_name = "DT_AARCH64_BTI_PLT"; break;
-					case DT_AARCH64_PAC_PLT: if (is_aarch64 && api_level < 31) removed_name = "DT_AARCH64_PAC_PLT"; break;
-					case DT_AARCH64_VARIANT_PCS: if (is_aarch64 && api_level < 31) removed_name = "DT_AARCH64_VARIANT_PCS"; break;
-				}
-				if (removed_name != nullptr) {
-					if (!quiet)
-						printf("%s: Removing the %s dynamic section entry from '%s'\n",
-						       PACKAGE_NAME, removed_name, file_name);
-					// Tag the entry with DT_NULL and put it last:
-					if (!dry_run) {
-						dynamic_section_entry->d_tag = DT_NULL;
-						// Decrease j to process new entry index:
-						std::swap(dynamic_section[j--], dynamic_section[last_nonnull_entry_idx--]);
-					}
-				} else if (dynamic_section_entry->d_tag == DT_FLAGS_1) {
-					// Remove unsupported DF_1_* flags to avoid linker warnings.
-					decltype(dynamic_section_entry->d_un.d_val) orig_d_val =
-						dynamic_section_entry->d_un.d_val;
-					decltype(dynamic_section_entry->d_un.d_val) new_d_val =
-						(orig_d_val & supported_dt_flags_1);
-					if (new_d_val != orig_d_val) {
-						if (!quiet)
-							printf("%s: Replacing unsupported DF_1_* flags %llu with %llu in '%s'\n",
-							       PACKAGE_NAME,
-							       (unsigned long long) orig_d_val,
-							       (unsigned long long) new_d_val,
-							       file_name);
-						if (!dry_run)
-							dynamic_section_entry->d_un.d_val = new_d_val;
-					}
+/* For --emit-patch: record the changes made to images of file_name,
+   read from the file at open_name as described by st, together with the
+   bytes they replace, instead of writing them.  */
+static int record_patch(std::span<elfcleaner::image* const> images, const char *file_name,
+			const char *open_name, struct stat const& st)
+{
+	int const fd = open(open_name, O_RDONLY);
+	if (fd < 0) {
+		perror_path("open", file_name);
+		return 1;
+	}
+	if (!unchanged_since(fd, st, file_name)) {
+		close(fd);
+		return 1;
+	}
+
+	// Ranges may overlap, within an image and between the images of an
+	// archive, so they are merged, and the new bytes are what the
+	// images would leave there when committed in order.
+	std::vector<elfcleaner::image::range> all;
+	for (auto* image : images)
+		for (auto const& range : image->modified_ranges())
+			all.push_back(range);
+	std::vector<std::pair<size_t, size_t>> spans;
+	for (auto const& range : all)
+		spans.push_back({range.offset, range.offset + range.length});
+	std::sort(spans.begin(), spans.end());
+
+	file_patch patch;
+	patch.name = file_name;
+	patch.size = st.st_size;
+	for (size_t i = 0; i < spans.size();) {
+		size_t const start = spans[i].first;
+		size_t end = spans[i].second;
+		for (i++; i < spans.size() && spans[i].first <= end; i++)
+			end = std::max(end, spans[i].second);
+
+		patch_range out;
+		out.offset = start;
+		out.old_bytes.resize(end - start);
+		if (!pread_fully(fd, out.old_bytes.data(), end - start, start)) {
+			perror_path("read", file_name);
+			close(fd);
+			return 1;
+		}
+		out.new_bytes = out.old_bytes;
+		for (auto const& range : all) {
+			size_t const from = std::max<size_t>(range.offset, start);
+			size_t const to = std::min<size_t>(range.offset + range.length, end);
+			if (from < to)
+				memcpy(out.new_bytes.data() + (from - start),
+				       range.data + (from - range.offset), to - from);
+		}
+		patch.ranges.push_back(std::move(out));
+	}
+	close(fd);
+
+	std::lock_guard<std::mutex> guard(emitted_lock);
+	emitted_patches.push_back(std::move(patch));
+	return 0;
+}
+
+/* Reopen file_name, by open_name, for writing and write out the changes
+   made to images, or write them to a copy of it with --output-dir and
+   --suffix.  st describes the descriptor the images were read from, to
+   make sure the same file is written.  */
+static int write_changes(std::span<elfcleaner::image* const> images, const char *file_name,
+			 const char *open_name, struct stat const& st,
+			 struct stat *clean_st, run_stats* stats)
+{
+	if (emit_patch != NULL)
+		return record_patch(images, file_name, open_name, st);
+
+	uint64_t time = stats ? stats_clock() : 0;
+	bool const copying = output_dir != NULL || output_suffix != NULL;
+	output_copy copy;
+	int fd;
+	if (copying) {
+		fd = start_copy(file_name, open_name, st, copy, stats);
+		if (fd < 0)
+			return 1;
+	} else {
+		fd = open(open_name, O_RDWR);
+		if (fd < 0) {
+			perror_path("open", file_name);
+			return 1;
+		}
+	}
+
+	int ret = 0;
+	if (!copying && !unchanged_since(fd, st, file_name)) {
+		ret = 1;
+	} else {
+		size_t written = 0;
+		bool const sync_now = sync_policy == SYNC_FILE;
+		uring* ring = io_engine == IO_ENGINE_URING ? thread_ring() : nullptr;
+		int const ring_ret = ring != nullptr ?
+			commit_with_ring(*ring, fd, images, sync_now, written) : 0;
+		if (ring_ret == -1) {
+			perror_path("pwrite", file_name);
+			ret = 1;
+		} else if (ring_ret == -2) {
+			log_perror("fdatasync()");
+			ret = 1;
+		} else if (ring_ret == 0) {
+			if (!std::all_of(images.begin(), images.end(),
+					 [fd](elfcleaner::image* image) { return image->commit(fd); })) {
+				perror_path("pwrite", file_name);
+				ret = 1;
+			} else {
+				time = stats_lap(stats, PHASE_WRITE, time);
+				if (sync_now && fdatasync(fd) < 0) {
+					log_perror("fdatasync()");
+					ret = 1;
 				}
 			}
-		} else if (api_level < 23 &&
-			 (section_header_entry->sh_type == SHT_GNU_verdef ||
-			  section_header_entry->sh_type == SHT_GNU_verneed ||
-			  section_header_entry->sh_type == SHT_GNU_versym)) {
-			if (!quiet)
-				switch (section_header_entry->sh_type) {
-				case SHT_GNU_verdef:
-					printf("%s: Removing VERDEF section from '%s'\n",
-					       PACKAGE_NAME, file_name);
-					break;
-				case SHT_GNU_verneed:
-					printf("%s: Removing VERNEED section from '%s'\n",
-					       PACKAGE_NAME, file_name);
-					break;
-				case SHT_GNU_versym:
-					printf("%s: Removing VERSYM section from '%s'\n",
-					       PACKAGE_NAME, file_name);
-					break;
-				}
-			if (!dry_run)
-				section_header_entry->sh_type = SHT_NULL;
+			for (auto* image : images)
+				written += image->committed_size();
 		}
+		if (ret == 0)
+			sync_later(fd);
+		// The original of a copy still needs the changes.
+		if (ret == 0 && clean_st != NULL && !copying && fstat(fd, clean_st) < 0)
+			clean_st->st_mode = 0;
+		// A round on the ring writes and syncs in one go; it counts as
+		// syncing.
+		time = stats_lap(stats, PHASE_SYNC, time);
+		if (stats != nullptr)
+			stats->bytes_written += written;
+	}
+
+	if (copying) {
+		if (ret == 0 && !publish_output_copy(copy))
+			ret = 1;
+		discard_output_copy(copy);
+	} else if (close(fd) != 0) {
+		log_perror("close()");
+		return 1;
+	}
+	stats_lap(stats, PHASE_WRITE, time);
+	return ret;
+}
+
+/* Point the CRC-32 of the zip entry held in member at its changed
+   contents, in all places it is stored.  The changes are recorded in
+   headers, which maps the whole file as bytes.  The old contents are
+   read from fd, which the changes have not been written to yet.  */
+static bool update_zip_crc(int fd, zip_entry const& entry,
+			   elfcleaner::image const& member,
+			   elfcleaner::buffer_image& headers, std::span<uint8_t> bytes)
+{
+	// The same bytes may be modified more than once, but each may only
+	// go into the CRC once.
+	std::vector<std::pair<size_t, size_t>> ranges;
+	for (auto const& range : member.modified_ranges())
+		ranges.push_back({range.offset, range.offset + range.length});
+	std::sort(ranges.begin(), ranges.end());
+
+	uint32_t crc = entry.crc;
+	std::vector<uint8_t> old_bytes;
+	for (size_t i = 0; i < ranges.size();) {
+		size_t const start = ranges[i].first;
+		size_t end = ranges[i].second;
+		for (i++; i < ranges.size() && ranges[i].first <= end; i++)
+			end = std::max(end, ranges[i].second);
+		old_bytes.resize(end - start);
+		if (!pread_fully(fd, old_bytes.data(), end - start, start))
+			return false;
+		crc = zip_crc32_patch(crc, entry.size, start - entry.offset,
+				      old_bytes.data(), bytes.data() + start, end - start);
+	}
+	for (size_t offset : entry.crc_offsets) {
+		uint8_t* p = bytes.data() + offset;
+		headers.modify(p, 4);
+		for (int i = 0; i < 4; i++)
+			p[i] = crc >> (8 * i);
 	}
 	return true;
 }
 
-int parse_file(const char *file_name)
+/* Clean the ELF members of the ar archive, or the native libraries in
+   the zip file, open as fd, spread over the pool, and write their
+   changes in one go.  Archives are mapped whatever the I/O engine, since
+   their members make up all of the file.  */
+static int process_archive(int fd, struct stat const& st, const char *file_name,
+			   const char *open_name, bool is_zip,
+			   elfcleaner::options const& opts, struct stat *clean_st,
+			   cache_residency* residency, run_stats* stats,
+			   stats_outcome& outcome, bool& modified)
 {
-	int fd = open(file_name, O_RDWR);
-	if (fd < 0) {
-		char* error_message;
-		if (asprintf(&error_message, "open(\"%s\")", file_name) == -1)
-			error_message = (char*) "open()";
-		perror(error_message);
+	modified = false;
+	outcome = OUTCOME_ERROR;
+
+	uint64_t time = stats ? stats_clock() : 0;
+	void* mem = mmap(0, st.st_size, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+	time = stats_lap(stats, PHASE_MAP, time);
+	if (mem == MAP_FAILED) {
+		log_perror("mmap()");
 		return 1;
 	}
+	if (stats != nullptr)
+		stats->bytes_mapped += st.st_size;
+	if (residency != nullptr)
+		residency->record(mem, st.st_size);
+	std::span<uint8_t> bytes(static_cast<uint8_t*>(mem), st.st_size);
 
-	struct stat st;
-	if (fstat(fd, &st) < 0) {
-		perror("fstat()");
-		if (close(fd) != 0)
-			perror("close()");
+	std::vector<ar_member> members;
+	std::vector<zip_entry> entries;
+	if (is_zip ? !parse_zip_entries(bytes, entries) : !parse_ar_members(bytes, members)) {
+		log_error("%s: Malformed %s '%s'", PACKAGE_NAME,
+			  is_zip ? "zip file" : "ar archive", file_name);
+		munmap(mem, st.st_size);
 		return 1;
 	}
+	for (auto const& entry : entries)
+		members.push_back({entry.offset, entry.size, entry.name});
+
+	std::vector<elfcleaner::buffer_image> images;
+	images.reserve(members.size());
+	for (auto const& member : members)
+		images.emplace_back(bytes.subspan(member.offset, member.size), member.offset);
+
+	// Members that are no ELF files come back as not_elf.
+	std::vector<elfcleaner::result> results(members.size());
+	auto clean_member = [&](size_t i) {
+		if (check && needs_changes.load(std::memory_order_relaxed))
+			return;
+		results[i] = elfcleaner::clean(images[i], opts);
+	};
+	if (file_pool != nullptr) {
+		file_pool->parallel_for(members.size(), clean_member);
+	} else {
+		for (size_t i = 0; i < members.size(); i++)
+			clean_member(i);
+	}
+	time = stats_lap(stats, PHASE_PROCESS, time);
 
+	// Report in member order, as name(member) like ar does.
+	int ret = 0;
+	outcome = OUTCOME_CLEAN;
+	std::vector<elfcleaner::image*> changed;
+	for (size_t i = 0; i < members.size(); i++) {
+		std::string const member_name = std::string(file_name) + "(" + members[i].name + ")";
+		stats_outcome member_outcome;
+		if (report_result(results[i], member_name.c_str(), opts, stats, member_outcome) != 0) {
+			ret = 1;
+			continue;
+		}
+		if (member_outcome == OUTCOME_MODIFIED)
+			outcome = OUTCOME_MODIFIED;
+		if (images[i].modified())
+			changed.push_back(&images[i]);
+	}
+
+	// Stored entries are changed in place, so only their CRC-32s need
+	// to follow; offsets and sizes stay the same.
+	elfcleaner::buffer_image headers(bytes);
+	if (is_zip && !changed.empty()) {
+		for (auto* image : changed) {
+			size_t const i = static_cast<elfcleaner::buffer_image*>(image) - images.data();
+			if (!update_zip_crc(fd, entries[i], *image, headers, bytes)) {
+				perror_path("read", file_name);
+				munmap(mem, st.st_size);
+				return 1;
+			}
+		}
+		changed.push_back(&headers);
+	}
+
+	// Members with errors are left as they are, the others still cleaned.
+	if (!changed.empty()) {
+		modified = true;
+		if (write_changes(changed, file_name, open_name, st, clean_st, stats) != 0)
+			ret = 1;
+	}
+	if (ret != 0)
+		outcome = OUTCOME_ERROR;
+
+	time = stats ? stats_clock() : 0;
+	munmap(mem, st.st_size);
+	stats_lap(stats, PHASE_MAP, time);
+	return ret;
+}
+
+/* What the first bytes of a file say about it.  */
+struct file_ident {
+	elfcleaner::result res;
+	bool is_archive = false;
+	bool is_zip = false;
+};
+
+/* Tell what the file of st is from its first EI_NIDENT bytes in ident,
+   which is only read for files large enough to be ELF files.  */
+static file_ident identify_file(uint8_t const* ident, struct stat const& st,
+				run_stats* stats)
+{
+	file_ident id;
 	if (st.st_size < (long long) sizeof(Elf32_Ehdr)) {
-		if (close(fd) != 0) {
-			perror("close()");
+		id.res.code = elfcleaner::status::not_elf;
+		return id;
+	}
+	if (stats != nullptr)
+		stats->bytes_read += EI_NIDENT;
+	id.res = elfcleaner::identify({ident, EI_NIDENT});
+	id.is_zip = memcmp(ident, ZIP_MAGIC, ZIP_MAGIC_SIZE) == 0;
+	id.is_archive = id.is_zip || memcmp(ident, AR_MAGIC, AR_MAGIC_SIZE) == 0;
+	if (id.res.code != elfcleaner::status::ok && !id.is_archive && stats != nullptr)
+		stats->ident_rejects++;
+	return id;
+}
+
+/* Clean the file open as fd, described by st and id, and leave fd open.
+   Files are read without write access first, and only reopened for
+   writing, by open_name, if process_elf() has changes to make, so clean
+   files are never opened writable, dirtied or synced.  With
+   --page-cache=sparse, which pages of the file were cached before is
+   recorded in residency, before any but the first are read.  */
+static int process_file(int fd, struct stat const& st, file_ident const& id,
+			const char *file_name, const char *open_name,
+			elfcleaner::options const& opts, struct stat *clean_st,
+			cache_residency* residency, run_stats* stats,
+			stats_outcome& outcome)
+{
+	if (id.res.code != elfcleaner::status::ok && !id.is_archive) {
+		int ret = report_status(id.res, file_name, outcome);
+		if (clean_st != NULL && ret == 0)
+			*clean_st = st;
+		return ret;
+	}
+	// Two workers must not clean the same file at once.
+	if (seen_files != nullptr && !seen_files->insert(st.st_dev, st.st_ino)) {
+		outcome = OUTCOME_DUPLICATE;
+		return 0;
+	}
+
+	uint64_t time = stats ? stats_clock() : 0;
+	int ret;
+	bool modified;
+	if (id.is_archive) {
+		ret = process_archive(fd, st, file_name, open_name, id.is_zip, opts, clean_st,
+				      residency, stats, outcome, modified);
+	} else if (io_engine == IO_ENGINE_PREAD || io_engine == IO_ENGINE_URING) {
+		if (residency != nullptr)
+			residency->record(fd, st.st_size);
+		pread_image image(fd, st.st_size);
+		ret = process_image(image, file_name, opts, stats, outcome);
+		stats_lap(stats, PHASE_PROCESS, time);
+		if (stats != nullptr)
+			stats->bytes_read += image.loaded_size();
+		modified = image.modified();
+		if (ret == 0 && modified) {
+			elfcleaner::image* images[] = {&image};
+			ret = write_changes(images, file_name, open_name, st, clean_st, stats);
+		}
+	} else {
+		// A private mapping, so that the changes can be made before
+		// deciding whether the file has to be written at all.
+		void* mem = mmap(0, st.st_size, PROT_READ | PROT_WRITE,
+				 MAP_PRIVATE, fd, 0);
+		time = stats_lap(stats, PHASE_MAP, time);
+		if (mem == MAP_FAILED) {
+			log_perror("mmap()");
 			return 1;
 		}
-		return 0;
+		if (stats != nullptr)
+			stats->bytes_mapped += st.st_size;
+		std::span<uint8_t> bytes(reinterpret_cast<uint8_t*>(mem), st.st_size);
+
+		// Without readahead, only the headers and the dynamic
+		// section are read, each asked for as a whole.
+		elfcleaner::buffer_image plain_image(bytes);
+		prefetch_image sparse_image(bytes);
+		if (residency != nullptr) {
+			madvise(mem, st.st_size, MADV_RANDOM);
+			residency->record(mem, st.st_size);
+		}
+		elfcleaner::buffer_image& image = residency != nullptr ? sparse_image : plain_image;
+		ret = process_image(image, file_name, opts, stats, outcome);
+		time = stats_lap(stats, PHASE_PROCESS, time);
+		modified = image.modified();
+		if (ret == 0 && modified) {
+			elfcleaner::image* images[] = {&image};
+			ret = write_changes(images, file_name, open_name, st, clean_st, stats);
+		}
+		time = stats ? stats_clock() : 0;
+		munmap(mem, st.st_size);
+		stats_lap(stats, PHASE_MAP, time);
 	}
 
-	void* mem = mmap(0, st.st_size, PROT_READ | PROT_WRITE,
-			 MAP_SHARED, fd, 0);
-	if (mem == MAP_FAILED) {
-		perror("mmap()");
-		if (close(fd) != 0)
-			perror("close()");
+	if (ret != 0)
+		outcome = OUTCOME_ERROR;
+	else if (modified)
+		outcome = OUTCOME_MODIFIED;
+	// Files that a dry run would change are not clean either.
+	if (clean_st != NULL && ret == 0 && outcome != OUTCOME_MODIFIED)
+		*clean_st = st;
+	return ret;
+}
+
+/* Close fd after process_file() returned ret.  */
+static int close_file(int fd, int ret, struct stat *clean_st, run_stats* stats,
+		      stats_outcome& outcome)
+{
+	uint64_t const time = stats ? stats_clock() : 0;
+	int const close_ret = close(fd);
+	stats_lap(stats, PHASE_CLOSE, time);
+	if (close_ret != 0) {
+		log_perror("close()");
+		outcome = OUTCOME_ERROR;
+		if (clean_st != NULL)
+			clean_st->st_mode = 0;
 		return 1;
 	}
+	return ret;
+}
 
-	uint8_t* bytes = reinterpret_cast<uint8_t*>(mem);
-	if (!(bytes[0] == 0x7F && bytes[1] == 'E' &&
-	      bytes[2] == 'L' && bytes[3] == 'F')) {
-		// Not the ELF magic number.
-		munmap(mem, st.st_size);
-		if (close(fd) != 0) {
-			perror("close()");
+/* Identify and clean the file open as fd, which is reopened for writing
+   by open_name, and leave fd open.  */
+static int parse_open_file(int fd, const char *file_name, const char *open_name,
+			   elfcleaner::options const& opts, struct stat *clean_st,
+			   run_stats* stats, stats_outcome& outcome)
+{
+	uint64_t time = stats ? stats_clock() : 0;
+	struct stat st;
+	int const stat_ret = fstat(fd, &st);
+	time = stats_lap(stats, PHASE_STAT, time);
+	if (stat_ret < 0) {
+		log_perror("fstat()");
+		return 1;
+	}
+
+	// Most files in a package tree are no ELF files at all, so tell
+	// from their first bytes, before anything is mapped.
+	bool const sparse = page_cache_policy == PAGE_CACHE_SPARSE;
+	bool first_page_cached = true;
+	if (sparse)
+		posix_fadvise(fd, 0, 0, POSIX_FADV_RANDOM);
+	uint8_t ident[EI_NIDENT];
+	if (st.st_size >= (long long) sizeof(Elf32_Ehdr)) {
+		bool const read_ok = sparse ?
+			pread_cached(fd, ident, sizeof(ident), first_page_cached) :
+			pread_fully(fd, ident, sizeof(ident), 0);
+		stats_lap(stats, PHASE_IDENT, time);
+		if (!read_ok) {
+			perror_path("read", file_name);
 			return 1;
 		}
+	}
+	file_ident const id = identify_file(ident, st, stats);
+	if (!sparse)
+		return process_file(fd, st, id, file_name, open_name, opts, clean_st,
+				    nullptr, stats, outcome);
+
+	cache_residency residency(first_page_cached);
+	int const ret = process_file(fd, st, id, file_name, open_name, opts, clean_st,
+				     &residency, stats, outcome);
+	residency.evict(fd);
+	return ret;
+}
+
+static int parse_file_phases(const char *file_name, const char *open_name,
+			     elfcleaner::options const& opts, struct stat *clean_st,
+			     run_stats* stats, stats_outcome& outcome)
+{
+	if (clean_st != NULL)
+		clean_st->st_mode = 0;
+	outcome = OUTCOME_ERROR;
+
+	uint64_t const time = stats ? stats_clock() : 0;
+	int fd = open(open_name, O_RDONLY);
+	stats_lap(stats, PHASE_OPEN, time);
+	if (fd < 0) {
+		perror_path("open", file_name);
+		return 1;
+	}
+
+	int const ret = parse_open_file(fd, file_name, open_name, opts, clean_st,
+					stats, outcome);
+	return close_file(fd, ret, clean_st, stats, outcome);
+}
+
+/* Log and count how processing the current file ended.  */
+static void record_outcome(stats_outcome outcome, elfcleaner::options const& opts,
+			   run_stats* stats)
+{
+	log_outcome(outcome);
+	if (outcome == OUTCOME_MODIFIED && opts.dry_run)
+		needs_changes.store(true, std::memory_order_relaxed);
+	if (stats != nullptr)
+		stats->outcomes[outcome]++;
+}
+
+/* parse_file() of the file at open_name, named file_name in messages.  */
+static int parse_named_file(const char *file_name, const char *open_name,
+			    elfcleaner::options const& opts, struct stat *clean_st)
+{
+	run_stats* stats = thread_stats();
+	stats_outcome outcome;
+	int ret = parse_file_phases(file_name, open_name, opts, clean_st, stats, outcome);
+	record_outcome(outcome, opts, stats);
+	return ret;
+}
+
+int parse_file(const char *file_name, elfcleaner::options const& opts,
+	       struct stat *clean_st)
+{
+	return parse_named_file(file_name, file_name, opts, clean_st);
+}
+
+int clean_buffer(std::span<uint8_t> bytes, const char *file_name,
+		 elfcleaner::options const& opts)
+{
+	run_stats* stats = thread_stats();
+	uint64_t time = stats ? stats_clock() : 0;
+	elfcleaner::buffer_image image(bytes);
+	stats_outcome outcome;
+	int const ret = process_image(image, file_name, opts, stats, outcome);
+	stats_lap(stats, PHASE_PROCESS, time);
+	if (ret == 0 && image.modified())
+		outcome = OUTCOME_MODIFIED;
+	record_outcome(outcome, opts, stats);
+	if (ret != 0)
+		had_errors.store(true, std::memory_order_relaxed);
+	return ret;
+}
+
+/* parse_named_file(), skipping files that the skip cache knows need no
+   changes and recording the ones that are clean afterwards.  */
+static int clean_file_cached(const char *file_name, const char *open_name,
+			     elfcleaner::options const& opts)
+{
+	if (!cache)
+		return parse_named_file(file_name, open_name, opts, NULL);
+
+	run_stats* stats = thread_stats();
+	uint64_t time = stats ? stats_clock() : 0;
+	struct stat st;
+	bool const known_clean = stat(open_name, &st) == 0 && cache->lookup(open_name, st, opts);
+	stats_lap(stats, PHASE_STAT, time);
+	if (known_clean) {
+		record_outcome(OUTCOME_SKIPPED, opts, stats);
 		return 0;
 	}
 
-	if (bytes[/*EI_DATA*/5] != 1) {
-		fprintf(stderr, "%s: Not little endianness in '%s'\n",
-			PACKAGE_NAME, file_name);
-		munmap(mem, st.st_size);
-		if (close(fd) != 0) {
-			perror("close()");
-			return 1;
+	int ret = parse_named_file(file_name, open_name, opts, &st);
+	if (st.st_mode != 0)
+		cache->insert(open_name, st, opts);
+	return ret;
+}
+
+/* clean_file_cached() with the messages logged at position seq.  */
+static int clean_file(const char *file_name, elfcleaner::options const& opts,
+		      uint64_t seq)
+{
+	log_begin(seq, file_name);
+	if (check && needs_changes.load(std::memory_order_relaxed)) {
+		log_end();
+		return 0;
+	}
+	run_stats* stats = thread_stats();
+	uint64_t const start = stats ? stats_clock() : 0;
+	int ret = clean_file_cached(file_name, file_name, opts);
+	if (stats != nullptr)
+		stats->add_latency(stats_clock() - start);
+	if (ret != 0)
+		had_errors.store(true, std::memory_order_relaxed);
+	log_end();
+	return ret;
+}
+
+int clean_client_file(const char *file_name, const char *open_name, int fd,
+		      elfcleaner::options const& opts, uint64_t seq, log_sink* sink)
+{
+	log_begin(seq, file_name, sink);
+	run_stats* stats = thread_stats();
+	uint64_t const start = stats ? stats_clock() : 0;
+	int ret;
+	if (fd < 0) {
+		ret = clean_file_cached(file_name, open_name, opts);
+	} else {
+		// The daemon only takes descriptors open for reading and
+		// writing; reopening one goes by its link in /proc, so that it
+		// reaches the file and not whatever now has the name.
+		char proc_name[32];
+		snprintf(proc_name, sizeof(proc_name), "/proc/self/fd/%d", fd);
+		stats_outcome outcome = OUTCOME_ERROR;
+		ret = parse_open_file(fd, file_name, proc_name, opts, NULL, stats, outcome);
+		record_outcome(outcome, opts, stats);
+	}
+	if (stats != nullptr)
+		stats->add_latency(stats_clock() - start);
+	if (ret != 0)
+		had_errors.store(true, std::memory_order_relaxed);
+	log_end();
+	return ret;
+}
+
+/* Apply patch to its file, after checking that each of its ranges holds
+   either the old bytes or, if the patch was applied before, the new.  */
+static int apply_patch_phases(file_patch const& patch, elfcleaner::options const& opts,
+			      run_stats* stats, stats_outcome& outcome)
+{
+	char const* name = patch.name.c_str();
+	uint64_t time = stats ? stats_clock() : 0;
+	int fd = open(name, opts.dry_run ? O_RDONLY : O_RDWR);
+	time = stats_lap(stats, PHASE_OPEN, time);
+	if (fd < 0) {
+		perror_path("open", name);
+		return 1;
+	}
+
+	struct stat st;
+	std::vector<bool> pending(patch.ranges.size());
+	size_t pending_count = 0;
+	int ret = 0;
+	if (fstat(fd, &st) < 0) {
+		log_perror("fstat()");
+		ret = 1;
+	} else if ((uint64_t) st.st_size != patch.size) {
+		log_error("%s: '%s' is not the file the patch was made for", PACKAGE_NAME, name);
+		ret = 1;
+	}
+	time = stats_lap(stats, PHASE_STAT, time);
+	std::vector<uint8_t> bytes;
+	for (size_t i = 0; ret == 0 && i < patch.ranges.size(); i++) {
+		patch_range const& range = patch.ranges[i];
+		bytes.resize(range.old_bytes.size());
+		if (!pread_fully(fd, bytes.data(), bytes.size(), range.offset)) {
+			perror_path("read", name);
+			ret = 1;
+		} else if (bytes == range.old_bytes) {
+			pending[i] = true;
+			pending_count++;
+		} else if (bytes != range.new_bytes) {
+			log_error("%s: '%s' is not the file the patch was made for",
+				  PACKAGE_NAME, name);
+			ret = 1;
+		}
+		if (stats != nullptr)
+			stats->bytes_read += bytes.size();
+	}
+	time = stats_lap(stats, PHASE_IDENT, time);
+
+	if (ret == 0 && pending_count == 0) {
+		outcome = OUTCOME_CLEAN;
+	} else if (ret == 0) {
+		outcome = OUTCOME_MODIFIED;
+		if (quiet) {
+		} else if (opts.stop_at_first_change) {
+			log_info("%s: '%s' needs changes", PACKAGE_NAME, name);
+		} else {
+			log_info("%s: Applying %zu patched ranges to '%s'",
+				 PACKAGE_NAME, pending_count, name);
+		}
+	}
+	if (ret == 0 && pending_count > 0 && !opts.dry_run) {
+		for (size_t i = 0; ret == 0 && i < patch.ranges.size(); i++) {
+			if (!pending[i])
+				continue;
+			patch_range const& range = patch.ranges[i];
+			if (!pwrite_fully(fd, range.new_bytes.data(), range.new_bytes.size(),
+					  range.offset)) {
+				perror_path("pwrite", name);
+				ret = 1;
+			} else if (stats != nullptr) {
+				stats->bytes_written += range.new_bytes.size();
+			}
+		}
+		time = stats_lap(stats, PHASE_WRITE, time);
+		if (ret == 0 && sync_policy == SYNC_FILE && fdatasync(fd) < 0) {
+			log_perror("fdatasync()");
+			ret = 1;
 		}
+		if (ret == 0)
+			sync_later(fd);
+		stats_lap(stats, PHASE_SYNC, time);
+	}
+	if (ret != 0)
+		outcome = OUTCOME_ERROR;
+	return close_file(fd, ret, NULL, stats, outcome);
+}
+
+/* apply_patch_phases() with the messages logged at position seq.  */
+static int apply_patch(file_patch const& patch, elfcleaner::options const& opts,
+		       uint64_t seq)
+{
+	log_begin(seq, patch.name.c_str());
+	if (check && needs_changes.load(std::memory_order_relaxed)) {
+		log_end();
 		return 0;
 	}
+	run_stats* stats = thread_stats();
+	uint64_t const start = stats ? stats_clock() : 0;
+	stats_outcome outcome = OUTCOME_ERROR;
+	int ret = apply_patch_phases(patch, opts, stats, outcome);
+	record_outcome(outcome, opts, stats);
+	if (stats != nullptr)
+		stats->add_latency(stats_clock() - start);
+	if (ret != 0)
+		had_errors.store(true, std::memory_order_relaxed);
+	log_end();
+	return ret;
+}
 
-	uint8_t const bit_value = bytes[/*EI_CLASS*/4];
-	if (bit_value == 1) {
-		if (!process_elf<Elf32_Word, Elf32_Ehdr, Elf32_Shdr, Elf32_Phdr,
-		    Elf32_Dyn>(bytes, st.st_size, file_name)) {
-			munmap(mem, st.st_size);
-			if (close(fd) != 0)
-				perror("close()");
-			return 1;
+/* The fields of stx that the rest of the code looks at, as a stat.  */
+static struct stat statx_to_stat(struct statx const& stx)
+{
+	struct stat st = {};
+	st.st_dev = makedev(stx.stx_dev_major, stx.stx_dev_minor);
+	st.st_ino = stx.stx_ino;
+	st.st_mode = stx.stx_mode;
+	st.st_nlink = stx.stx_nlink;
+	st.st_size = stx.stx_size;
+	st.st_mtim.tv_sec = stx.stx_mtime.tv_sec;
+	st.st_mtim.tv_nsec = stx.stx_mtime.tv_nsec;
+	return st;
+}
+
+/* A file to clean, with its position in the output.  */
+struct batch_file {
+	std::string name;
+	uint64_t seq;
+};
+
+/* Estimated time to clean the file at file_name, for starting the
+   longest first.  Files that the skip cache knows to be clean cost just
+   a stat(), and the others more the larger they are: large files have
+   large section header tables, archives many members, and copies and
+   reads from storage grow with the size.  */
+static uint64_t estimate_cost(char const* file_name, elfcleaner::options const& opts)
+{
+	struct stat st;
+	if (stat(file_name, &st) != 0 || !S_ISREG(st.st_mode))
+		return 0;
+	if (cache && cache->peek(file_name, st, opts))
+		return 0;
+	return st.st_size;
+}
+
+/* Like clean_file() for every file in files, but with their opens, their
+   stats together with their first reads, and their closes each submitted
+   to the worker's ring as one round, so a worker waits for a batch of
+   files at a time instead of for each system call.  With a skip cache,
+   the files are stat()ed by name in a round of their own first, and only
+   those it does not know to be clean are opened.  Falls back to
+   clean_file() if the ring cannot be used.  */
+static void clean_batch(std::vector<batch_file> const& files,
+			elfcleaner::options const& opts)
+{
+	struct state {
+		int fd = -1;
+		int open_error = 0;
+		int stat_error = 0;
+		int read_result = 0;
+		bool skipped = false;
+		bool looked_up = false;
+		struct statx stx;
+		uint8_t ident[EI_NIDENT];
+	};
+
+	uring* ring = thread_ring();
+	std::vector<state> states(files.size());
+	run_stats* stats = thread_stats();
+	uint64_t time = stats ? stats_clock() : 0;
+	uint64_t const start = time;
+
+	bool ring_ok = ring != nullptr;
+	if (ring_ok && cache) {
+		for (size_t i = 0; ring_ok && i < files.size(); i++) {
+			io_uring_sqe* sqe = ring->next_sqe();
+			if (sqe == nullptr) {
+				ring_ok = false;
+				break;
+			}
+			sqe->opcode = IORING_OP_STATX;
+			sqe->fd = AT_FDCWD;
+			sqe->addr = reinterpret_cast<uint64_t>(files[i].name.c_str());
+			sqe->len = STATX_BASIC_STATS;
+			sqe->off = reinterpret_cast<uint64_t>(&states[i].stx);
+			sqe->user_data = i;
+		}
+		// Files that cannot be stat()ed by name are opened anyway, for
+		// the open to report why.
+		ring_ok = ring_ok && ring->run([&](uint64_t i, int32_t res) {
+			if (res < 0)
+				return;
+			struct stat st = statx_to_stat(states[i].stx);
+			states[i].looked_up = true;
+			states[i].skipped = cache->lookup(files[i].name.c_str(), st, opts);
+		});
+		time = stats_lap(stats, PHASE_STAT, time);
+	}
+	for (size_t i = 0; ring_ok && i < files.size(); i++) {
+		if (states[i].skipped)
+			continue;
+		io_uring_sqe* sqe = ring->next_sqe();
+		if (sqe == nullptr) {
+			ring_ok = false;
+			break;
 		}
-	} else if (bit_value == 2) {
-		if (!process_elf<Elf64_Xword, Elf64_Ehdr, Elf64_Shdr,
-		    Elf64_Phdr, Elf64_Dyn>(bytes, st.st_size, file_name)) {
-			munmap(mem, st.st_size);
-			if (close(fd) != 0)
-				perror("close()");
+		sqe->opcode = IORING_OP_OPENAT;
+		sqe->fd = AT_FDCWD;
+		sqe->addr = reinterpret_cast<uint64_t>(files[i].name.c_str());
+		sqe->open_flags = O_RDONLY;
+		sqe->user_data = i;
+	}
+	ring_ok = ring_ok && ring->run([&](uint64_t i, int32_t res) {
+		if (res >= 0)
+			states[i].fd = res;
+		else
+			states[i].open_error = -res;
+	});
+	if (!ring_ok) {
+		for (auto const& st : states)
+			if (st.fd >= 0)
+				close(st.fd);
+		for (auto const& file : files)
+			clean_file(file.name.c_str(), opts, file.seq);
+		return;
+	}
+	time = stats_lap(stats, PHASE_OPEN, time);
+
+	// A round that fails from here on is reported against each file.
+	int round_error = 0;
+	for (size_t i = 0; i < files.size(); i++) {
+		if (states[i].fd < 0)
+			continue;
+		io_uring_sqe* sqe = ring->next_sqe();
+		sqe->opcode = IORING_OP_STATX;
+		sqe->fd = states[i].fd;
+		sqe->addr = reinterpret_cast<uint64_t>("");
+		sqe->statx_flags = AT_EMPTY_PATH;
+		sqe->len = STATX_BASIC_STATS;
+		sqe->off = reinterpret_cast<uint64_t>(&states[i].stx);
+		sqe->user_data = 2 * i;
+		sqe = ring->next_sqe();
+		sqe->opcode = IORING_OP_READ;
+		sqe->fd = states[i].fd;
+		sqe->addr = reinterpret_cast<uint64_t>(states[i].ident);
+		sqe->len = EI_NIDENT;
+		sqe->user_data = 2 * i + 1;
+	}
+	if (!ring->run([&](uint64_t id, int32_t res) {
+		if (id % 2 == 0)
+			states[id / 2].stat_error = res < 0 ? -res : 0;
+		else
+			states[id / 2].read_result = res;
+	}))
+		round_error = errno;
+	time = stats_lap(stats, PHASE_IDENT, time);
+	uint64_t const io_share = (time - start) / files.size();
+
+	for (size_t i = 0; i < files.size(); i++) {
+		char const* name = files[i].name.c_str();
+		state& f = states[i];
+		log_begin(files[i].seq, name);
+		if (check && needs_changes.load(std::memory_order_relaxed)) {
+			log_end();
+			continue;
+		}
+		uint64_t const file_start = stats ? stats_clock() : 0;
+
+		int ret = 1;
+		stats_outcome outcome = OUTCOME_ERROR;
+		struct stat const st = statx_to_stat(f.stx);
+		struct stat clean_st;
+		clean_st.st_mode = 0;
+		if (f.skipped) {
+			ret = 0;
+			outcome = OUTCOME_SKIPPED;
+		} else if (f.open_error != 0) {
+			errno = f.open_error;
+			perror_path("open", name);
+		} else if (round_error != 0 || f.stat_error != 0) {
+			errno = round_error != 0 ? round_error : f.stat_error;
+			log_perror("statx()");
+		} else if (cache && !f.looked_up && cache->lookup(name, st, opts)) {
+			ret = 0;
+			outcome = OUTCOME_SKIPPED;
+		} else if (st.st_size >= (long long) sizeof(Elf32_Ehdr) && f.read_result != EI_NIDENT) {
+			// Read from the start of a file this large, it cannot be
+			// short but for an error.
+			errno = f.read_result < 0 ? -f.read_result : EIO;
+			perror_path("read", name);
+		} else {
+			file_ident const id = identify_file(f.ident, st, stats);
+			ret = process_file(f.fd, st, id, name, name, opts, &clean_st, nullptr,
+					   stats, outcome);
+			if (cache && clean_st.st_mode != 0)
+				cache->insert(name, st, opts);
+		}
+		record_outcome(outcome, opts, stats);
+		if (stats != nullptr)
+			stats->add_latency(io_share + stats_clock() - file_start);
+		if (ret != 0)
+			had_errors.store(true, std::memory_order_relaxed);
+		log_end();
+	}
+
+	time = stats ? stats_clock() : 0;
+	for (size_t i = 0; i < files.size(); i++) {
+		io_uring_sqe* sqe = states[i].fd >= 0 ? ring->next_sqe() : nullptr;
+		if (sqe == nullptr) {
+			if (states[i].fd >= 0)
+				close(states[i].fd);
+			continue;
+		}
+		sqe->opcode = IORING_OP_CLOSE;
+		sqe->fd = states[i].fd;
+		sqe->user_data = i;
+	}
+	// The messages of the files are out already, and a close after
+	// reading cannot lose data, so a failure is only reported.
+	ring->run([&](uint64_t i, int32_t res) {
+		if (res < 0) {
+			errno = -res;
+			perror_path("close", files[i].name.c_str());
+			had_errors.store(true, std::memory_order_relaxed);
+		}
+	});
+	stats_lap(stats, PHASE_CLOSE, time);
+}
+
+/* Pass every name listed in list_file, or stdin if list_file is "-",
+   to submit as soon as it has been read.  */
+static int read_file_list(char const* list_file,
+			  std::function<void(std::string)> const& submit)
+{
+	FILE* stream = stdin;
+	if (strcmp(list_file, "-") != 0) {
+		stream = fopen(list_file, "r");
+		if (stream == NULL) {
+			perror_path("fopen", list_file);
 			return 1;
 		}
-	} else {
-		fprintf(stderr, "%s: Incorrect bit value %d in '%s'\n",
-			PACKAGE_NAME, bit_value, file_name);
-		munmap(mem, st.st_size);
-		if (close(fd) != 0)
-			perror("close()");
-		return 1;
 	}
 
-	if (msync(mem, st.st_size, MS_SYNC) < 0) {
-		perror("msync()");
-		munmap(mem, st.st_size);
-		if (close(fd) != 0)
-			perror("close()");
-		return 1;
+	int const delimiter = null_separated ? '\0' : '\n';
+	char* line = NULL;
+	size_t line_capacity = 0;
+	ssize_t line_length;
+	while ((line_length = getdelim(&line, &line_capacity, delimiter, stream)) != -1) {
+		if (check && needs_changes.load(std::memory_order_relaxed))
+			break;
+		if (line_length > 0 && line[line_length - 1] == delimiter)
+			line_length--;
+		if (line_length > 0)
+			submit(std::string(line, line_length));
 	}
+	free(line);
 
-	munmap(mem, st.st_size);
-	close(fd);
-	return 0;
+	int ret = 0;
+	if (ferror(stream)) {
+		perror_path("getdelim", list_file);
+		ret = 1;
+	}
+	if (stream != stdin)
+		fclose(stream);
+	return ret;
+}
+
+/* Print the summaries asked for and return the exit status for a run
+   that returned ret.  */
+static int finish(int ret)
+{
+	if (!sync_filesystems())
+		ret = 1;
+	if (cache && !quiet)
+		fprintf(stderr, "%s: Skip cache: %llu hits, %llu misses\n",
+			PACKAGE_NAME, (unsigned long long) cache->hit_count(),
+			(unsigned long long) cache->miss_count());
+	if (stats_format != STATS_FORMAT_NONE)
+		stats_print(stderr, stats_format == STATS_FORMAT_JSON);
+
+	if (check)
+		return needs_changes ? 1 : (had_errors || ret != 0) ? 2 : 0;
+	return ret;
 }
 
 int main(int argc, char **argv)
@@ -314,12 +1444,43 @@ int main(int argc, char **argv)
 	int c;
 	int options_index = 0;
 	int threads_count = std::thread::hardware_concurrency();
+	/* Default to api level 21 unless arg --api-level given  */
+	int api_level = 21;
+	walk_filter filter;
+	char const* files_from = NULL;
+	char const* cache_file = NULL;
+	char const* daemon_socket = NULL;
+	char const* client_socket = NULL;
+	char const* watch_dir = NULL;
+	char const* apply_patch_file = NULL;
 
 	static struct option options[] = {
 		{"api-level", required_argument, NULL, 'a'},
 		{"dry-run", no_argument, &dry_run, 1},
+		{"check", no_argument, &check, 1},
+		{"tar-filter", no_argument, &tar_filter, 1},
+		{"daemon", required_argument, NULL, 'D'},
+		{"client", required_argument, NULL, 'C'},
 		{"jobs", required_argument, NULL, 'j'},
 		{"quiet", no_argument, &quiet, 1},
+		{"recursive", no_argument, &recursive, 1},
+		{"include", required_argument, NULL, 'I'},
+		{"exclude", required_argument, NULL, 'X'},
+		{"watch", required_argument, NULL, 'W'},
+		{"output-dir", required_argument, NULL, 'O'},
+		{"suffix", required_argument, NULL, 'S'},
+		{"emit-patch", required_argument, NULL, 'E'},
+		{"apply-patch", required_argument, NULL, 'P'},
+		{"sync", required_argument, NULL, 'Y'},
+		{"page-cache", required_argument, NULL, 'K'},
+		{"order", required_argument, NULL, 'R'},
+		{"files-from", required_argument, NULL, 'f'},
+		{"null", no_argument, &null_separated, 1},
+		{"io-engine", required_argument, NULL, 'e'},
+		{"cache", required_argument, NULL, 'c'},
+		{"cache-xattr", no_argument, &cache_xattr, 1},
+		{"stats", optional_argument, NULL, 's'},
+		{"log-format", required_argument, NULL, 'l'},
 		{"help", no_argument, NULL, 'h'},
 		{"version", no_argument, NULL, 'v'},
 		{0, 0, 0, 0}
@@ -327,7 +1488,7 @@ int main(int argc, char **argv)
 
 	while (true)
 	{
-		c = getopt_long(argc, argv, "hva:dqj:",
+		c = getopt_long(argc, argv, "hva:dqj:0",
 				options, &options_index);
 
 		if (c == -1)
@@ -344,6 +1505,112 @@ int main(int argc, char **argv)
 			if (threads_count < 1)
 				threads_count = 1;
 			break;
+		case 'I':
+			filter.include.push_back(optarg);
+			break;
+		case 'X':
+			filter.exclude.push_back(optarg);
+			break;
+		case 'W':
+			watch_dir = optarg;
+			break;
+		case 'O':
+			output_dir = optarg;
+			break;
+		case 'S':
+			output_suffix = optarg;
+			break;
+		case 'E':
+			emit_patch = optarg;
+			break;
+		case 'Y':
+			if (strcmp(optarg, "none") == 0) {
+				sync_policy = SYNC_NONE;
+			} else if (strcmp(optarg, "file") == 0) {
+				sync_policy = SYNC_FILE;
+			} else if (strcmp(optarg, "batch") == 0) {
+				sync_policy = SYNC_BATCH;
+			} else {
+				fprintf(stderr, "%s: Unknown sync policy '%s'\n",
+					PACKAGE_NAME, optarg);
+				return 1;
+			}
+			break;
+		case 'K':
+			if (strcmp(optarg, "normal") == 0) {
+				page_cache_policy = PAGE_CACHE_NORMAL;
+			} else if (strcmp(optarg, "sparse") == 0) {
+				page_cache_policy = PAGE_CACHE_SPARSE;
+			} else {
+				fprintf(stderr, "%s: Unknown page cache policy '%s'\n",
+					PACKAGE_NAME, optarg);
+				return 1;
+			}
+			break;
+		case 'R':
+			if (strcmp(optarg, "largest") == 0) {
+				file_order = FILE_ORDER_LARGEST;
+				order_listed = 1;
+			} else if (strcmp(optarg, "given") == 0) {
+				file_order = FILE_ORDER_GIVEN;
+			} else {
+				fprintf(stderr, "%s: Unknown order '%s'\n", PACKAGE_NAME, optarg);
+				return 1;
+			}
+			break;
+		case 'P':
+			apply_patch_file = optarg;
+			break;
+		case 'f':
+			files_from = optarg;
+			break;
+		case '0':
+			null_separated = 1;
+			break;
+		case 'c':
+			cache_file = optarg;
+			break;
+		case 'D':
+			daemon_socket = optarg;
+			break;
+		case 'C':
+			client_socket = optarg;
+			break;
+		case 'l':
+			if (strcmp(optarg, "text") == 0) {
+				log_format = LOG_FORMAT_TEXT;
+			} else if (strcmp(optarg, "json") == 0) {
+				log_format = LOG_FORMAT_JSON;
+			} else {
+				fprintf(stderr, "%s: Unknown log format '%s'\n",
+					PACKAGE_NAME, optarg);
+				return 1;
+			}
+			break;
+		case 's':
+			if (optarg == NULL || strcmp(optarg, "text") == 0) {
+				stats_format = STATS_FORMAT_TEXT;
+			} else if (strcmp(optarg, "json") == 0) {
+				stats_format = STATS_FORMAT_JSON;
+			} else {
+				fprintf(stderr, "%s: Unknown stats format '%s'\n",
+					PACKAGE_NAME, optarg);
+				return 1;
+			}
+			break;
+		case 'e':
+			if (strcmp(optarg, "mmap") == 0) {
+				io_engine = IO_ENGINE_MMAP;
+			} else if (strcmp(optarg, "pread") == 0) {
+				io_engine = IO_ENGINE_PREAD;
+			} else if (strcmp(optarg, "uring") == 0) {
+				io_engine = IO_ENGINE_URING;
+			} else {
+				fprintf(stderr, "%s: Unknown I/O engine '%s'\n",
+					PACKAGE_NAME, optarg);
+				return 1;
+			}
+			break;
 		case 'v':
 			printf("%s %s\n", PACKAGE_NAME, PACKAGE_VERSION);
 			printf(("%s\n"
@@ -362,7 +1629,93 @@ int main(int argc, char **argv)
 		}
 	}
 
-	if (optind >= argc) {
+	elfcleaner::options opts = elfcleaner::make_options(api_level, dry_run || check);
+	opts.stop_at_first_change = check;
+
+	if (tar_filter) {
+		if (optind < argc || files_from != NULL || recursive) {
+			fprintf(stderr, "%s: --tar-filter reads stdin and takes no files\n",
+				PACKAGE_NAME);
+			return 1;
+		}
+		// The stream goes to stdout, so the messages go to stderr.
+		log_set_output(stderr);
+		if (stats_format != STATS_FORMAT_NONE)
+			stats_init(0);
+		return finish(filter_tar_stream(STDIN_FILENO, STDOUT_FILENO, opts));
+	}
+
+	if (daemon_socket != NULL && (optind < argc || files_from != NULL || recursive ||
+				      watch_dir != NULL)) {
+		fprintf(stderr, "%s: --daemon takes its files from clients\n",
+			PACKAGE_NAME);
+		return 1;
+	}
+	if (daemon_socket != NULL && (output_dir != NULL || output_suffix != NULL ||
+				      emit_patch != NULL || apply_patch_file != NULL)) {
+		fprintf(stderr, "%s: --daemon cleans files in place\n", PACKAGE_NAME);
+		return 1;
+	}
+	if (sync_policy == SYNC_BATCH && (daemon_socket != NULL || watch_dir != NULL)) {
+		fprintf(stderr, "%s: --sync=batch only syncs at the end of a run, which "
+			"--daemon and --watch do not have\n", PACKAGE_NAME);
+		return 1;
+	}
+	if (emit_patch != NULL && (dry_run || check || output_dir != NULL ||
+				   output_suffix != NULL || apply_patch_file != NULL)) {
+		fprintf(stderr, "%s: --emit-patch records the changes and writes no files\n",
+			PACKAGE_NAME);
+		return 1;
+	}
+	if (apply_patch_file != NULL && (optind < argc || files_from != NULL || recursive ||
+					 watch_dir != NULL)) {
+		fprintf(stderr, "%s: --apply-patch takes its files from the manifest\n",
+			PACKAGE_NAME);
+		return 1;
+	}
+	if (watch_dir != NULL && (optind < argc || files_from != NULL || recursive)) {
+		fprintf(stderr, "%s: --watch takes no other files\n", PACKAGE_NAME);
+		return 1;
+	}
+
+	// Only what the daemon takes per request is forwarded; other runs
+	// are done here, as are all runs if no daemon is listening.
+	std::vector<std::string> listed_files;
+	if (client_socket != NULL && !recursive && watch_dir == NULL &&
+	    output_dir == NULL && output_suffix == NULL && emit_patch == NULL &&
+	    apply_patch_file == NULL &&
+	    stats_format == STATS_FORMAT_NONE) {
+		if (files_from != NULL) {
+			int const ret = read_file_list(files_from, [&listed_files](std::string file) {
+				listed_files.push_back(std::move(file));
+			});
+			if (ret != 0)
+				return ret;
+			files_from = NULL;
+		}
+
+		daemon_request req;
+		char* cwd = getcwd(NULL, 0);
+		if (cwd != NULL)
+			req.cwd = cwd;
+		free(cwd);
+		req.api_level = api_level;
+		req.dry_run = dry_run;
+		req.check = check;
+		req.json = log_format == LOG_FORMAT_JSON;
+		req.files.assign(argv + optind, argv + argc);
+		req.files.insert(req.files.end(), listed_files.begin(), listed_files.end());
+
+		int const status = run_client(client_socket, req);
+		if (status >= 0)
+			return status;
+		if (!quiet)
+			fprintf(stderr, "%s: No daemon is listening on '%s', cleaning here\n",
+				PACKAGE_NAME, client_socket);
+	}
+
+	if (daemon_socket == NULL && watch_dir == NULL && apply_patch_file == NULL &&
+	    optind >= argc && files_from == NULL && listed_files.empty()) {
 		printf("Usage: %s [OPTION-OR-FILENAME]...\n", argv[0]);
 		for (unsigned int i = 0; i < ARRAYELTS(usage_message); i++)
 			fputs(usage_message[i], stdout);
@@ -370,27 +1723,160 @@ int main(int argc, char **argv)
 	}
 
 	int files_count = argc - (optind);
-	if (argc - (optind) <= threads_count)
+	if (daemon_socket == NULL && watch_dir == NULL && apply_patch_file == NULL &&
+	    !recursive && files_from == NULL && listed_files.empty() &&
+	    argc - (optind) <= threads_count)
 		threads_count = files_count;
 
-	if (api_level >= 23) {
-		// The supported DT_FLAGS_1 values as of Android 6.0.
-		supported_dt_flags_1 = (DF_1_NOW | DF_1_GLOBAL | DF_1_NODELETE);
+	if (cache_file != NULL && cache_xattr) {
+		fprintf(stderr, "%s: --cache and --cache-xattr cannot be combined\n",
+			PACKAGE_NAME);
+		return 1;
+	}
+	if (cache_file != NULL) {
+		cache = open_index_skip_cache(cache_file);
+		if (!cache)
+			return 1;
+	} else if (cache_xattr) {
+		cache = open_xattr_skip_cache();
+	}
+
+	if (io_engine == IO_ENGINE_URING && !uring().init(URING_ENTRIES)) {
+		if (!quiet)
+			fprintf(stderr, "%s: io_uring is not available (%s), using mmap\n",
+				PACKAGE_NAME, strerror(errno));
+		io_engine = IO_ENGINE_MMAP;
 	}
 
-	std::vector<std::future<void>> futures;
-	std::counting_semaphore sem(threads_count);
+	if (stats_format != STATS_FORMAT_NONE)
+		stats_init(threads_count);
+
+	// Watched files may be written again after they were cleaned, and
+	// the daemon's clients send files again when they want them looked at.
+	// Copies and patch entries are made per name and leave the file alone.
+	inode_set seen;
+	if (watch_dir == NULL && daemon_socket == NULL && output_dir == NULL &&
+	    output_suffix == NULL && emit_patch == NULL)
+		seen_files = &seen;
+
+	worker_pool pool(threads_count, threads_count * PENDING_FILES_PER_JOB);
+	file_pool = &pool;
+
+	if (daemon_socket != NULL)
+		return finish(run_daemon(daemon_socket, pool));
 
-	for (int i = optind; i < argc; i++) {
-		sem.acquire();
-		const char* file = argv[i];
-		futures.push_back(std::async([file, &sem]() {
-			parse_file(file);
-			sem.release();
-		}));
+	if (apply_patch_file != NULL) {
+		std::vector<file_patch> patches;
+		if (!read_patch_manifest(apply_patch_file, patches))
+			return finish(1);
+		for (file_patch const& patch : patches) {
+			if (check && needs_changes.load(std::memory_order_relaxed))
+				break;
+			uint64_t const seq = log_reserve();
+			pool.submit([&patch, &opts, seq]() {
+				apply_patch(patch, opts, seq);
+			});
+		}
+		pool.wait();
+		return finish(0);
 	}
 
-	for (auto& future : futures) future.get();
+	// Output positions are taken when a file is submitted, so messages
+	// come out in the order of the arguments and list, and of discovery
+	// with --recursive.
+	std::mutex batch_lock;
+	std::vector<batch_file> batch;
+	auto submit_batch = [&pool, &opts](std::vector<batch_file> files) {
+		pool.submit([files = std::move(files), &opts]() {
+			clean_batch(files, opts);
+		});
+	};
+	auto submit_reserved = [&](batch_file file) {
+		// Watched files come a few at a time and are not held back
+		// for a batch to fill.  Batches read the first bytes of files
+		// without telling whether they were cached, which
+		// --page-cache=sparse needs to know.
+		if (io_engine == IO_ENGINE_URING && watch_dir == NULL &&
+		    page_cache_policy != PAGE_CACHE_SPARSE) {
+			std::unique_lock<std::mutex> guard(batch_lock);
+			batch.push_back(std::move(file));
+			if (batch.size() < URING_BATCH_FILES)
+				return;
+			std::vector<batch_file> full;
+			full.swap(batch);
+			guard.unlock();
+			submit_batch(std::move(full));
+			return;
+		}
+		pool.submit([file = std::move(file), &opts]() {
+			clean_file(file.name.c_str(), opts, file.seq);
+		});
+	};
+	auto submit_file = [&](std::string file) {
+		if (check && needs_changes.load(std::memory_order_relaxed))
+			return;
+		submit_reserved({std::move(file), log_reserve()});
+	};
 
-	return 0;
+	// A single huge file started last would keep the run going long
+	// after the other workers ran out of files, so files given as
+	// arguments, which are cheap to stat up front, are started largest
+	// first.  The stat()s are spread over the idle workers.
+	std::vector<batch_file> window;
+	size_t window_files = ORDER_WINDOW_FILES;
+	auto submit_window = [&]() {
+		std::vector<uint64_t> costs(window.size());
+		pool.parallel_for(window.size(), [&](size_t i) {
+			costs[i] = estimate_cost(window[i].name.c_str(), opts);
+		});
+		std::vector<size_t> order(window.size());
+		for (size_t i = 0; i < order.size(); i++)
+			order[i] = i;
+		std::stable_sort(order.begin(), order.end(), [&costs](size_t a, size_t b) {
+			return costs[a] > costs[b];
+		});
+		for (size_t i : order)
+			submit_reserved(std::move(window[i]));
+		window.clear();
+	};
+	auto submit_path = [&](std::string file) {
+		if (recursive) {
+			walk_tree(pool, file, filter, submit_file,
+				  check ? &needs_changes : nullptr);
+		} else if (file_order == FILE_ORDER_LARGEST && window_files != 0) {
+			if (check && needs_changes.load(std::memory_order_relaxed))
+				return;
+			window.push_back({std::move(file), log_reserve()});
+			if (window.size() == window_files)
+				submit_window();
+		} else {
+			submit_file(std::move(file));
+		}
+	};
+
+	for (int i = optind; i < argc; i++)
+		submit_path(argv[i]);
+	submit_window();
+	window_files = order_listed ? ORDER_LIST_WINDOW_FILES : 0;
+	for (std::string& file : listed_files)
+		submit_path(std::move(file));
+
+	int ret = 0;
+	if (files_from != NULL)
+		ret = read_file_list(files_from, submit_path);
+	submit_window();
+	if (watch_dir != NULL)
+		ret = watch_tree(watch_dir, filter, submit_file);
+
+	pool.wait();
+	// Walks are done now, so the last batch is complete.
+	if (!batch.empty()) {
+		submit_batch(std::move(batch));
+		pool.wait();
+	}
+
+	if (emit_patch != NULL && !write_patch_manifest(emit_patch, emitted_patches))
+		ret = 1;
+
+	return finish(ret);
 }
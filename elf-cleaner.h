@@ -0,0 +1,98 @@
+/* termux-elf-cleaner
+
+Copyright (C) 2026 Termux
+
+This file is part of termux-elf-cleaner.
+
+termux-elf-cleaner is free software: you can redistribute it and/or
+modify it under the terms of the GNU General Public License as
+published by the Free Software Foundation, either version 3 of the
+License, or (at your option) any later version.
+
+termux-elf-cleaner is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with termux-elf-cleaner.  If not, see
+<https://www.gnu.org/licenses/>.  */
+
+#ifndef ELF_CLEANER_H
+#define ELF_CLEANER_H
+
+#include <stdint.h>
+#include <sys/stat.h>
+
+#include <span>
+
+#include "elfcleaner.h"
+
+class log_sink;
+
+enum io_engine_type {
+	IO_ENGINE_MMAP,
+	IO_ENGINE_PREAD,
+	IO_ENGINE_URING,
+};
+
+enum sync_policy_type {
+	SYNC_NONE,
+	SYNC_FILE,
+	SYNC_BATCH,
+};
+
+enum page_cache_policy_type {
+	PAGE_CACHE_NORMAL,
+	PAGE_CACHE_SPARSE,
+};
+
+enum file_order_type {
+	FILE_ORDER_LARGEST,
+	FILE_ORDER_GIVEN,
+};
+
+enum stats_format_type {
+	STATS_FORMAT_NONE,
+	STATS_FORMAT_TEXT,
+	STATS_FORMAT_JSON,
+};
+
+enum log_format_type {
+	LOG_FORMAT_TEXT,
+	LOG_FORMAT_JSON,
+};
+
+/* Options shared by the parts of the command line tool.  */
+extern int quiet;
+extern int io_engine;
+extern int sync_policy;
+extern int page_cache_policy;
+extern int file_order;
+extern int stats_format;
+extern int log_format;
+
+/* Clean file_name.  Returns 0 on success and 1 on error.  If clean_st
+   is given it receives the stat of the file when it was left needing no
+   further changes, and has st_mode 0 otherwise.  */
+int parse_file(const char *file_name, elfcleaner::options const& opts,
+	       struct stat *clean_st = NULL);
+
+/* Clean the file held in bytes in place, naming it file_name in
+   messages, which are logged and counted like those of parse_file().
+   Returns 0 on success and 1 on error.  */
+int clean_buffer(std::span<uint8_t> bytes, const char *file_name,
+		 elfcleaner::options const& opts);
+
+/* Clean a file for a client of the daemon, named file_name in messages:
+   the one at open_name or, if fd is not -1, the one open as fd.  Its
+   messages are logged at position seq, to sink.  Returns 0 on success
+   and 1 on error; fd is left open.  */
+int clean_client_file(const char *file_name, const char *open_name, int fd,
+		      elfcleaner::options const& opts, uint64_t seq, log_sink* sink);
+
+/* Like perror(), but formats the message as call("path").  Goes to the
+   messages of the file being processed, if any.  */
+void perror_path(const char *call, const char *path);
+
+#endif
@@ -0,0 +1,328 @@
+/* termux-elf-cleaner
+
+Copyright (C) 2026 Termux
+
+This file is part of termux-elf-cleaner.
+
+termux-elf-cleaner is free software: you can redistribute it and/or
+modify it under the terms of the GNU General Public License as
+published by the Free Software Foundation, either version 3 of the
+License, or (at your option) any later version.
+
+termux-elf-cleaner is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with termux-elf-cleaner.  If not, see
+<https://www.gnu.org/licenses/>.  */
+
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE
+#endif
+
+#include <errno.h>
+#include <unistd.h>
+
+#include <algorithm>
+
+// Include a local elf.h copy as not all platforms have it.
+#include "elf.h"
+#include "elfcleaner.h"
+
+namespace elfcleaner {
+
+static bool truncated(result& res, char const* part, size_t end, size_t file_size)
+{
+	res.code = status::truncated;
+	res.truncated_part = part;
+	res.truncated_end = end;
+	res.file_size = file_size;
+	return false;
+}
+
+static bool read_error(result& res)
+{
+	res.code = status::read_error;
+	res.error = errno;
+	return false;
+}
+
+template<typename ElfWord /*Elf{32_Word,64_Xword}*/,
+	 typename ElfHeaderType /*Elf{32,64}_Ehdr*/,
+	 typename ElfSectionHeaderType /*Elf{32,64}_Shdr*/,
+	 typename ElfProgramHeaderType /*Elf{32,64}_Phdr*/,
+	 typename ElfDynamicSectionEntryType /* Elf{32,64}_Dyn */>
+bool process_elf(image& image, options const& opts, result& res)
+{
+	size_t const elf_file_size = image.size();
+	if (sizeof(ElfHeaderType) > elf_file_size)
+		return truncated(res, "Elf header", sizeof(ElfHeaderType), elf_file_size);
+	ElfHeaderType* elf_hdr = reinterpret_cast<ElfHeaderType*>(image.load(0, sizeof(ElfHeaderType)));
+	if (elf_hdr == nullptr)
+		return read_error(res);
+
+	bool is_aarch64 = (elf_hdr->e_machine == 183); /* EM_AARCH64 */
+
+	/* Check TLS segment alignment in program headers if api level is < 29 */
+	size_t last_program_header_byte = elf_hdr->e_phoff + sizeof(ElfProgramHeaderType) * elf_hdr->e_phnum;
+	if (last_program_header_byte > elf_file_size)
+		return truncated(res, "Program header", last_program_header_byte, elf_file_size);
+	ElfProgramHeaderType* program_header_table = reinterpret_cast<ElfProgramHeaderType*>(
+		image.load(elf_hdr->e_phoff, sizeof(ElfProgramHeaderType) * elf_hdr->e_phnum));
+	if (program_header_table == nullptr)
+		return read_error(res);
+
+	size_t tls_min_alignment = sizeof(ElfWord)*8;
+	/* Iterate over program headers */
+	for (unsigned int i = 1; i < elf_hdr->e_phnum; i++) {
+		ElfProgramHeaderType* program_header_entry = program_header_table + i;
+		if (program_header_entry->p_type == PT_TLS &&
+		    program_header_entry->p_align < tls_min_alignment) {
+			res.changes.push_back({change_kind::tls_alignment, nullptr,
+					       program_header_entry->p_align, tls_min_alignment});
+			if (!opts.dry_run) {
+				image.modify(reinterpret_cast<uint8_t*>(&program_header_entry->p_align),
+					     sizeof(program_header_entry->p_align));
+				program_header_entry->p_align = tls_min_alignment;
+			}
+			if (opts.stop_at_first_change)
+				return true;
+		}
+	}
+
+	/* With SHN_LORESERVE or more sections, e_shnum is 0 and the count is
+	   in the sh_size of the first section header. */
+	size_t section_count = elf_hdr->e_shnum;
+	if (section_count == 0 && elf_hdr->e_shoff != 0) {
+		size_t const first_section_header_byte = elf_hdr->e_shoff + sizeof(ElfSectionHeaderType);
+		if (first_section_header_byte > elf_file_size)
+			return truncated(res, "Section header", first_section_header_byte, elf_file_size);
+		ElfSectionHeaderType* first_section_header = reinterpret_cast<ElfSectionHeaderType*>(
+			image.load(elf_hdr->e_shoff, sizeof(ElfSectionHeaderType)));
+		if (first_section_header == nullptr)
+			return read_error(res);
+		section_count = first_section_header->sh_size;
+		if (section_count > elf_file_size / sizeof(ElfSectionHeaderType))
+			return truncated(res, "Section header", SIZE_MAX, elf_file_size);
+	}
+
+	size_t last_section_header_byte = elf_hdr->e_shoff + sizeof(ElfSectionHeaderType) * section_count;
+	if (last_section_header_byte > elf_file_size)
+		return truncated(res, "Section header", last_section_header_byte, elf_file_size);
+	ElfSectionHeaderType* section_header_table = reinterpret_cast<ElfSectionHeaderType*>(
+		image.load(elf_hdr->e_shoff, sizeof(ElfSectionHeaderType) * section_count));
+	if (section_header_table == nullptr)
+		return read_error(res);
+
+	/* Iterate over section headers */
+	for (size_t i = 1; i < section_count; i++) {
+		ElfSectionHeaderType* section_header_entry = section_header_table + i;
+		if (section_header_entry->sh_type == SHT_DYNAMIC) {
+			size_t const last_dynamic_section_byte = section_header_entry->sh_offset + section_header_entry->sh_size;
+			if (last_dynamic_section_byte > elf_file_size)
+				return truncated(res, "Dynamic section", last_dynamic_section_byte, elf_file_size);
+
+			size_t const dynamic_section_entries = section_header_entry->sh_size / sizeof(ElfDynamicSectionEntryType);
+			if (dynamic_section_entries == 0)
+				continue;
+			ElfDynamicSectionEntryType* const dynamic_section =
+				reinterpret_cast<ElfDynamicSectionEntryType*>(
+					image.load(section_header_entry->sh_offset, section_header_entry->sh_size));
+			if (dynamic_section == nullptr)
+				return read_error(res);
+
+			unsigned int last_nonnull_entry_idx = 0;
+			for (unsigned int j = dynamic_section_entries - 1; j > 0; j--) {
+				ElfDynamicSectionEntryType* dynamic_section_entry = dynamic_section + j;
+				if (dynamic_section_entry->d_tag != DT_NULL) {
+					last_nonnull_entry_idx = j;
+					break;
+				}
+			}
+			for (unsigned int j = 0; j < dynamic_section_entries; j++) {
+				ElfDynamicSectionEntryType* dynamic_section_entry = dynamic_section + j;
+
+				char const* removed_name = nullptr;
+				switch (dynamic_section_entry->d_tag) {
+					case DT_GNU_HASH: if (opts.api_level < 23) removed_name = "DT_GNU_HASH"; break;
+					case DT_VERSYM: if (opts.api_level < 23) removed_name = "DT_VERSYM"; break;
+					case DT_VERNEED: if (opts.api_level < 23) removed_name = "DT_VERNEED"; break;
+					case DT_VERNEEDNUM: if (opts.api_level < 23) removed_name = "DT_VERNEEDNUM"; break;
+					case DT_VERDEF: if (opts.api_level < 23) removed_name = "DT_VERDEF"; break;
+					case DT_VERDEFNUM: if (opts.api_level < 23) removed_name = "DT_VERDEFNUM"; break;
+					case DT_RPATH: removed_name = "DT_RPATH"; break;
+					case DT_RUNPATH: if (opts.api_level < 24) removed_name = "DT_RUNPATH"; break;
+					case DT_AARCH64_BTI_PLT: if (is_aarch64 && opts.api_level < 31) removed_name = "DT_AARCH64_BTI_PLT"; break;
+					case DT_AARCH64_PAC_PLT: if (is_aarch64 && opts.api_level < 31) removed_name = "DT_AARCH64_PAC_PLT"; break;
+					case DT_AARCH64_VARIANT_PCS: if (is_aarch64 && opts.api_level < 31) removed_name = "DT_AARCH64_VARIANT_PCS"; break;
+				}
+				if (removed_name != nullptr) {
+					res.changes.push_back({change_kind::dynamic_entry_removed, removed_name,
+							       0, 0});
+					// Tag the entry with DT_NULL and put it last:
+					if (!opts.dry_run) {
+						image.modify(reinterpret_cast<uint8_t*>(dynamic_section_entry),
+							     sizeof(*dynamic_section_entry));
+						image.modify(reinterpret_cast<uint8_t*>(dynamic_section + last_nonnull_entry_idx),
+							     sizeof(*dynamic_section_entry));
+						dynamic_section_entry->d_tag = DT_NULL;
+						// Decrease j to process new entry index:
+						std::swap(dynamic_section[j--], dynamic_section[last_nonnull_entry_idx--]);
+					}
+					if (opts.stop_at_first_change)
+						return true;
+				} else if (dynamic_section_entry->d_tag == DT_FLAGS_1) {
+					// Remove unsupported DF_1_* flags to avoid linker warnings.
+					decltype(dynamic_section_entry->d_un.d_val) orig_d_val =
+						dynamic_section_entry->d_un.d_val;
+					decltype(dynamic_section_entry->d_un.d_val) new_d_val =
+						(orig_d_val & opts.supported_dt_flags_1);
+					if (new_d_val != orig_d_val) {
+						res.changes.push_back({change_kind::dt_flags_1_replaced, nullptr,
+								       orig_d_val, new_d_val});
+						if (!opts.dry_run) {
+							image.modify(reinterpret_cast<uint8_t*>(&dynamic_section_entry->d_un.d_val),
+								     sizeof(dynamic_section_entry->d_un.d_val));
+							dynamic_section_entry->d_un.d_val = new_d_val;
+						}
+						if (opts.stop_at_first_change)
+							return true;
+					}
+				}
+			}
+		} else if (opts.api_level < 23 &&
+			 (section_header_entry->sh_type == SHT_GNU_verdef ||
+			  section_header_entry->sh_type == SHT_GNU_verneed ||
+			  section_header_entry->sh_type == SHT_GNU_versym)) {
+			char const* removed_name = nullptr;
+			switch (section_header_entry->sh_type) {
+			case SHT_GNU_verdef: removed_name = "VERDEF"; break;
+			case SHT_GNU_verneed: removed_name = "VERNEED"; break;
+			case SHT_GNU_versym: removed_name = "VERSYM"; break;
+			}
+			res.changes.push_back({change_kind::section_removed, removed_name, 0, 0});
+			if (!opts.dry_run) {
+				image.modify(reinterpret_cast<uint8_t*>(&section_header_entry->sh_type),
+					     sizeof(section_header_entry->sh_type));
+				section_header_entry->sh_type = SHT_NULL;
+			}
+			if (opts.stop_at_first_change)
+				return true;
+		}
+	}
+	return true;
+}
+
+options make_options(int api_level, bool dry_run)
+{
+	options opts;
+	opts.api_level = api_level;
+	opts.dry_run = dry_run;
+	opts.stop_at_first_change = false;
+	if (api_level >= 23) {
+		// The supported DT_FLAGS_1 values as of Android 6.0.
+		opts.supported_dt_flags_1 = (DF_1_NOW | DF_1_GLOBAL | DF_1_NODELETE);
+	} else {
+		opts.supported_dt_flags_1 = (DF_1_NOW | DF_1_GLOBAL);
+	}
+	return opts;
+}
+
+result identify(std::span<uint8_t const> ident)
+{
+	result res;
+	if (ident.size() < EI_NIDENT) {
+		res.code = status::not_elf;
+		return res;
+	}
+
+	if (!(ident[0] == 0x7F && ident[1] == 'E' &&
+	      ident[2] == 'L' && ident[3] == 'F')) {
+		// Not the ELF magic number.
+		res.code = status::not_elf;
+		return res;
+	}
+
+	if (ident[EI_DATA] != ELFDATA2LSB) {
+		res.code = status::big_endian;
+		return res;
+	}
+
+	res.elf_class = ident[EI_CLASS];
+	if (res.elf_class != ELFCLASS32 && res.elf_class != ELFCLASS64)
+		res.code = status::bad_class;
+	return res;
+}
+
+result clean(image& img, options const& opts)
+{
+	if (img.size() < EI_NIDENT) {
+		result res;
+		res.code = status::not_elf;
+		res.file_size = img.size();
+		return res;
+	}
+
+	uint8_t const* ident = img.load(0, std::min(img.size(), sizeof(Elf64_Ehdr)));
+	if (ident == nullptr) {
+		result res;
+		res.file_size = img.size();
+		read_error(res);
+		return res;
+	}
+
+	result res = identify({ident, EI_NIDENT});
+	res.file_size = img.size();
+	if (res.code != status::ok)
+		return res;
+
+	if (res.elf_class == ELFCLASS32) {
+		process_elf<Elf32_Word, Elf32_Ehdr, Elf32_Shdr, Elf32_Phdr,
+			    Elf32_Dyn>(img, opts, res);
+	} else {
+		process_elf<Elf64_Xword, Elf64_Ehdr, Elf64_Shdr,
+			    Elf64_Phdr, Elf64_Dyn>(img, opts, res);
+	}
+	return res;
+}
+
+result clean(std::span<uint8_t> bytes, options const& opts)
+{
+	buffer_image img(bytes);
+	return clean(img, opts);
+}
+
+bool image::commit(int fd)
+{
+	// Merge ranges that touch within the same loaded buffer, so rewriting
+	// a dynamic section entry by entry turns into a single write.
+	std::sort(dirty.begin(), dirty.end(), [](range const& a, range const& b) {
+		return a.offset < b.offset;
+	});
+	size_t i = 0;
+	while (i < dirty.size()) {
+		size_t const start = dirty[i].offset;
+		uint8_t const* data = dirty[i].data;
+		size_t end = start + dirty[i].length;
+		for (i++; i < dirty.size(); i++) {
+			if (dirty[i].offset > end || dirty[i].data != data + (dirty[i].offset - start))
+				break;
+			end = std::max(end, dirty[i].offset + dirty[i].length);
+		}
+		for (size_t offset = start; offset < end;) {
+			ssize_t n = pwrite(fd, data + (offset - start), end - offset, offset);
+			if (n < 0) {
+				if (errno == EINTR)
+					continue;
+				return false;
+			}
+			offset += n;
+			committed += n;
+		}
+	}
+	return true;
+}
+
+}
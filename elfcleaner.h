@@ -0,0 +1,187 @@
+/* termux-elf-cleaner
+
+Copyright (C) 2026 Termux
+
+This file is part of termux-elf-cleaner.
+
+termux-elf-cleaner is free software: you can redistribute it and/or
+modify it under the terms of the GNU General Public License as
+published by the Free Software Foundation, either version 3 of the
+License, or (at your option) any later version.
+
+termux-elf-cleaner is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with termux-elf-cleaner.  If not, see
+<https://www.gnu.org/licenses/>.  */
+
+/* libelfcleaner: removes the section types and dynamic section entries
+   that the Android linker warns about from ELF files held in memory, or
+   behind any other elfcleaner::image.  Calls share no state, so any
+   number of them may run concurrently on different images.  */
+
+#ifndef ELFCLEANER_H
+#define ELFCLEANER_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <span>
+#include <vector>
+
+namespace elfcleaner {
+
+/* Bump whenever the cleaning rules change, so that files recorded as
+   clean by an older version are checked again.  */
+constexpr int ruleset_version = 2;
+
+struct options {
+	/* Android api level the files must load on without warnings.  */
+	int api_level;
+	/* DF_1_* flags the linker of api_level supports; others are removed.  */
+	uint64_t supported_dt_flags_1;
+	/* Report the changes without making them.  */
+	bool dry_run;
+	/* Return after the first change, when all that matters is whether
+	   the file needs any.  Meant to be combined with dry_run.  */
+	bool stop_at_first_change;
+};
+
+/* Options for api_level with the matching supported DF_1_* flags.  */
+options make_options(int api_level, bool dry_run = false);
+
+enum class change_kind {
+	/* The p_align of the PT_TLS segment was raised.  */
+	tls_alignment,
+	/* A SHT_GNU_ver{def,need,sym} section was turned into SHT_NULL.  */
+	section_removed,
+	/* A dynamic entry was replaced by DT_NULL and moved to the end.  */
+	dynamic_entry_removed,
+	/* Unsupported DF_1_* flags were cleared from DT_FLAGS_1.  */
+	dt_flags_1_replaced,
+};
+
+struct change {
+	change_kind kind;
+	/* VERDEF, VERNEED or VERSYM for sections, the DT_* tag name for
+	   dynamic entries, nullptr otherwise.  */
+	char const* name;
+	/* The alignment or DT_FLAGS_1 value before and after the change.  */
+	uint64_t old_value;
+	uint64_t new_value;
+};
+
+enum class status {
+	/* An ELF file that was processed; see changes.  */
+	ok,
+	/* No ELF magic number; nothing was done.  */
+	not_elf,
+	/* A big-endian ELF file, which Android never loads; nothing was done.  */
+	big_endian,
+	/* EI_CLASS is neither ELFCLASS32 nor ELFCLASS64; see elf_class.  */
+	bad_class,
+	/* A header table or dynamic section lies past the end of the file;
+	   see truncated_part, truncated_end and file_size.  */
+	truncated,
+	/* image::load() failed; see error.  */
+	read_error,
+};
+
+struct result {
+	status code = status::ok;
+	/* In the order they were made.  When code is truncated or
+	   read_error, the changes made before the problem was found remain.  */
+	std::vector<change> changes;
+
+	uint8_t elf_class = 0;
+	char const* truncated_part = nullptr;
+	size_t truncated_end = 0;
+	size_t file_size = 0;
+	int error = 0;
+};
+
+/* The parts of an ELF file that clean() looks at.  Ranges are loaded on
+   demand and stay valid until the image is destroyed.  Changes only
+   affect the loaded copy until commit() writes them out.  */
+class image {
+public:
+	struct range {
+		size_t offset;
+		size_t length;
+		uint8_t* data;
+	};
+
+	explicit image(size_t size) : file_size(size) {}
+	virtual ~image() {}
+
+	size_t size() const { return file_size; }
+
+	/* Return length bytes at offset, or nullptr with errno set if they
+	   could not be read.  The caller has checked them against size().  */
+	virtual uint8_t* load(size_t offset, size_t length) = 0;
+
+	/* Must be called before changing length bytes at p, which lie
+	   inside a single range returned by load().  */
+	virtual void modify(uint8_t* p, size_t length) = 0;
+
+	bool modified() const { return !dirty.empty(); }
+
+	/* The ranges passed to modify(), at their offsets in the file that
+	   commit() writes to, and with their changed bytes.  */
+	std::span<range const> modified_ranges() const { return dirty; }
+
+	/* Write the modified ranges to fd, which refers to the same file.
+	   Returns false and sets errno on failure.  */
+	bool commit(int fd);
+
+	/* Bytes written by commit() so far.  */
+	size_t committed_size() const { return committed; }
+
+protected:
+	void mark_dirty(size_t offset, size_t length, uint8_t* data)
+	{
+		dirty.push_back({offset, length, data});
+	}
+
+	size_t const file_size;
+
+private:
+	std::vector<range> dirty;
+	size_t committed = 0;
+};
+
+/* An image of a file in memory, changed in place.  The bytes may also be
+   a part of a larger file, such as an archive member, that starts at
+   base in it; commit() then writes to the right place.  */
+class buffer_image : public image {
+public:
+	explicit buffer_image(std::span<uint8_t> bytes, size_t base = 0)
+		: image(bytes.size()), bytes(bytes.data()), base(base) {}
+
+	uint8_t* load(size_t offset, size_t) override { return bytes + offset; }
+	void modify(uint8_t* p, size_t length) override { mark_dirty(base + (p - bytes), length, p); }
+
+private:
+	uint8_t* const bytes;
+	size_t const base;
+};
+
+/* Check the EI_NIDENT bytes at the start of a file.  The code of the
+   result is ok for a little-endian ELF32 or ELF64 file, which clean()
+   would process, and otherwise what clean() would return without
+   looking further.  */
+result identify(std::span<uint8_t const> ident);
+
+/* Clean the ELF file in bytes in place.  */
+result clean(std::span<uint8_t> bytes, options const& opts);
+
+/* Clean the ELF file behind img, leaving the changes in its loaded
+   ranges.  */
+result clean(image& img, options const& opts);
+
+}
+
+#endif
@@ -0,0 +1,373 @@
+/* termux-elf-cleaner
+
+Copyright (C) 2026 Termux
+
+This file is part of termux-elf-cleaner.
+
+termux-elf-cleaner is free software: you can redistribute it and/or
+modify it under the terms of the GNU General Public License as
+published by the Free Software Foundation, either version 3 of the
+License, or (at your option) any later version.
+
+termux-elf-cleaner is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with termux-elf-cleaner.  If not, see
+<https://www.gnu.org/licenses/>.  */
+
+#include <errno.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <string.h>
+
+#include <atomic>
+#include <condition_variable>
+#include <map>
+#include <mutex>
+#include <string>
+
+#include "elf-cleaner.h"
+#include "file-log.h"
+#include "worker-pool.h"
+
+namespace {
+
+struct record {
+	std::string file_name;
+	char const* outcome = nullptr;
+	log_sink* sink = nullptr;
+	bool json = false;
+	/* Text: the lines for stdout and stderr.  JSON: the elements of the
+	   changes and errors arrays.  */
+	std::string out;
+	std::string err;
+
+	bool empty() const { return out.empty() && err.empty(); }
+
+	void clear()
+	{
+		// Keeps the capacity, so each worker reuses its buffers.
+		file_name.clear();
+		outcome = nullptr;
+		sink = nullptr;
+		json = log_format == LOG_FORMAT_JSON;
+		out.clear();
+		err.clear();
+	}
+};
+
+}
+
+/* An output order: the next position to reserve and to write, and the
+   records that finished before an earlier one, by position.  */
+struct log_order {
+	std::atomic<uint64_t> next_reserved{0};
+	std::mutex lock;
+	std::condition_variable advanced;
+	uint64_t next_output = 0;
+	std::map<uint64_t, record> finished;
+};
+
+namespace {
+
+/* The order of stdout and stderr.  */
+log_order output_order;
+
+/* Where stdout lines go; stdout unless log_set_output() was called.  */
+FILE* output_stream = nullptr;
+
+thread_local record current_record;
+thread_local uint64_t current_seq;
+thread_local bool collecting = false;
+
+void append_json_string(std::string& out, char const* s)
+{
+	out += '"';
+	for (; *s; s++) {
+		unsigned char const c = *s;
+		if (c == '"' || c == '\\') {
+			out += '\\';
+			out += c;
+		} else if (c < 0x20) {
+			char escape[8];
+			snprintf(escape, sizeof(escape), "\\u%04x", c);
+			out += escape;
+		} else {
+			out += c;
+		}
+	}
+	out += '"';
+}
+
+FILE* out_stream()
+{
+	return output_stream != nullptr ? output_stream : stdout;
+}
+
+/* Write rec out; called with the lock of its order held.  */
+void write_record(record const& rec)
+{
+	if (rec.json) {
+		// A sink counts every record, and leaves --quiet to its reader.
+		if (quiet && rec.err.empty() && rec.sink == nullptr)
+			return;
+		std::string line = "{";
+		if (!rec.file_name.empty()) {
+			line += "\"file\": ";
+			append_json_string(line, rec.file_name.c_str());
+			line += ", ";
+		}
+		if (rec.outcome != nullptr) {
+			line += "\"outcome\": \"";
+			line += rec.outcome;
+			line += "\", ";
+		}
+		line += "\"changes\": [" + rec.out + "], \"errors\": [" + rec.err + "]}\n";
+		if (rec.sink != nullptr)
+			rec.sink->write(line, {}, rec.outcome);
+		else
+			fwrite(line.data(), 1, line.size(), out_stream());
+	} else if (rec.sink != nullptr) {
+		rec.sink->write(rec.out, rec.err, rec.outcome);
+	} else {
+		fwrite(rec.out.data(), 1, rec.out.size(), out_stream());
+		if (!rec.err.empty()) {
+			// Keep the two streams in order when they go to the same place.
+			fflush(out_stream());
+			fwrite(rec.err.data(), 1, rec.err.size(), stderr);
+		}
+	}
+}
+
+void flush_output()
+{
+	fflush(out_stream());
+	fflush(stderr);
+}
+
+/* Write out what a thread that is not processing a file logged.  */
+void write_unordered()
+{
+	std::lock_guard<std::mutex> guard(output_order.lock);
+	current_record.json = log_format == LOG_FORMAT_JSON;
+	write_record(current_record);
+	flush_output();
+	current_record.clear();
+}
+
+/* Append format and args to out, however long the result is.  */
+void append_vformat(std::string& out, char const* format, va_list args)
+{
+	va_list again;
+	va_copy(again, args);
+	int const n = vsnprintf(nullptr, 0, format, args);
+	if (n > 0) {
+		size_t const start = out.size();
+		out.resize(start + n + 1);
+		vsnprintf(&out[start], n + 1, format, again);
+		out.resize(start + n);
+	}
+	va_end(again);
+}
+
+void append_change(std::string& out, char const* format, ...) __attribute__((format(printf, 2, 3)));
+
+void append_change(std::string& out, char const* format, ...)
+{
+	va_list args;
+	va_start(args, format);
+	append_vformat(out, format, args);
+	va_end(args);
+}
+
+}
+
+void log_set_output(FILE* stream)
+{
+	output_stream = stream;
+}
+
+log_sink::log_sink() : order(std::make_shared<log_order>()) {}
+
+log_sink::~log_sink() {}
+
+uint64_t log_reserve(log_sink* sink)
+{
+	log_order& order = sink != nullptr ? *sink->order : output_order;
+	uint64_t const seq = order.next_reserved.fetch_add(1, std::memory_order_relaxed);
+	// Workers are not held back, since the file output waits for may be
+	// queued behind them.
+	if (seq >= LOG_ORDER_WINDOW && worker_pool::current_worker() < 0) {
+		std::unique_lock<std::mutex> guard(order.lock);
+		order.advanced.wait(guard, [&order, seq]() {
+			return seq - order.next_output < LOG_ORDER_WINDOW;
+		});
+	}
+	return seq;
+}
+
+void log_begin(uint64_t seq, char const* file_name, log_sink* sink)
+{
+	current_record.clear();
+	current_record.file_name = file_name;
+	current_record.sink = sink;
+	if (sink != nullptr)
+		current_record.json = sink->json();
+	current_seq = seq;
+	collecting = true;
+}
+
+bool log_json()
+{
+	return collecting ? current_record.json : log_format == LOG_FORMAT_JSON;
+}
+
+void log_end()
+{
+	collecting = false;
+	// A sink may be gone as soon as it has written its last record, so
+	// its order is kept here until unlocked.
+	log_sink* const sink = current_record.sink;
+	std::shared_ptr<log_order> const sink_order = sink != nullptr ? sink->order : nullptr;
+	log_order& order = sink_order ? *sink_order : output_order;
+	std::lock_guard<std::mutex> guard(order.lock);
+	if (current_seq != order.next_output) {
+		order.finished.emplace(current_seq, std::move(current_record));
+		return;
+	}
+
+	bool wrote = !current_record.empty() || current_record.json;
+	write_record(current_record);
+	order.next_output++;
+	for (auto it = order.finished.begin();
+	     it != order.finished.end() && it->first == order.next_output;
+	     it = order.finished.erase(it)) {
+		wrote = wrote || !it->second.empty() || it->second.json;
+		write_record(it->second);
+		order.next_output++;
+	}
+	order.advanced.notify_all();
+	if (wrote && sink == nullptr)
+		flush_output();
+}
+
+void log_changes(char const* file_name, elfcleaner::result const& res)
+{
+	using elfcleaner::change_kind;
+
+	std::string& out = current_record.out;
+	bool const json = log_json();
+	for (auto const& c : res.changes) {
+		if (json) {
+			if (!out.empty())
+				out += ", ";
+			// Changes to archive members name the member.
+			if (collecting && current_record.file_name != file_name) {
+				out += "{\"member\": ";
+				append_json_string(out, file_name);
+				out += ", ";
+			} else {
+				out += "{";
+			}
+			switch (c.kind) {
+			case change_kind::tls_alignment:
+				append_change(out, "\"kind\": \"tls_alignment\", \"old\": %llu, \"new\": %llu}",
+					      (unsigned long long) c.old_value,
+					      (unsigned long long) c.new_value);
+				break;
+			case change_kind::section_removed:
+				append_change(out, "\"kind\": \"section_removed\", \"name\": \"%s\"}", c.name);
+				break;
+			case change_kind::dynamic_entry_removed:
+				append_change(out, "\"kind\": \"dynamic_entry_removed\", \"name\": \"%s\"}", c.name);
+				break;
+			case change_kind::dt_flags_1_replaced:
+				append_change(out, "\"kind\": \"dt_flags_1_replaced\", \"old\": %llu, \"new\": %llu}",
+					      (unsigned long long) c.old_value,
+					      (unsigned long long) c.new_value);
+				break;
+			}
+			continue;
+		}
+
+		switch (c.kind) {
+		case change_kind::tls_alignment:
+			append_change(out, "%s: Changing TLS alignment for '%s' to %u, instead of %u\n",
+				      PACKAGE_NAME, file_name,
+				      (unsigned int) c.new_value, (unsigned int) c.old_value);
+			break;
+		case change_kind::section_removed:
+			append_change(out, "%s: Removing %s section from '%s'\n",
+				      PACKAGE_NAME, c.name, file_name);
+			break;
+		case change_kind::dynamic_entry_removed:
+			append_change(out, "%s: Removing the %s dynamic section entry from '%s'\n",
+				      PACKAGE_NAME, c.name, file_name);
+			break;
+		case change_kind::dt_flags_1_replaced:
+			append_change(out, "%s: Replacing unsupported DF_1_* flags %llu with %llu in '%s'\n",
+				      PACKAGE_NAME,
+				      (unsigned long long) c.old_value,
+				      (unsigned long long) c.new_value,
+				      file_name);
+			break;
+		}
+	}
+
+	if (!collecting) {
+		current_record.file_name = file_name;
+		write_unordered();
+	}
+}
+
+void log_outcome(stats_outcome outcome)
+{
+	if (collecting)
+		current_record.outcome = stats_outcome_name(outcome);
+}
+
+void log_info(char const* format, ...)
+{
+	if (log_json())
+		return;
+
+	va_list args;
+	va_start(args, format);
+	append_vformat(current_record.out, format, args);
+	va_end(args);
+	current_record.out += '\n';
+
+	if (!collecting)
+		write_unordered();
+}
+
+void log_error(char const* format, ...)
+{
+	std::string message;
+	va_list args;
+	va_start(args, format);
+	append_vformat(message, format, args);
+	va_end(args);
+
+	std::string& err = current_record.err;
+	if (log_json()) {
+		if (!err.empty())
+			err += ", ";
+		append_json_string(err, message.c_str());
+	} else {
+		err += message;
+		err += '\n';
+	}
+
+	if (!collecting)
+		write_unordered();
+}
+
+void log_perror(char const* s)
+{
+	int const saved_errno = errno;
+	log_error("%s: %s", s, strerror(saved_errno));
+}
@@ -0,0 +1,114 @@
+/* termux-elf-cleaner
+
+Copyright (C) 2026 Termux
+
+This file is part of termux-elf-cleaner.
+
+termux-elf-cleaner is free software: you can redistribute it and/or
+modify it under the terms of the GNU General Public License as
+published by the Free Software Foundation, either version 3 of the
+License, or (at your option) any later version.
+
+termux-elf-cleaner is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with termux-elf-cleaner.  If not, see
+<https://www.gnu.org/licenses/>.  */
+
+#ifndef ELF_CLEANER_FILE_LOG_H
+#define ELF_CLEANER_FILE_LOG_H
+
+#include <stdint.h>
+#include <stdio.h>
+
+#include <memory>
+#include <string>
+
+#include "elfcleaner.h"
+#include "stats.h"
+
+/* Messages about each input file are collected in a buffer of the
+   worker processing it and written out as a whole, in the order the
+   files were submitted: as soon as every earlier file is done, not at
+   the end of the run.
+
+   In text format the changes go to stdout and errors to stderr as
+   lines.  In JSON format every file is one line on stdout with its
+   name, outcome, changes and errors.  Messages logged by a thread that
+   is not processing a file are written out right away.  */
+
+struct log_order;
+
+/* Receives the records of some files instead of stdout and stderr,
+   such as those of a client of the daemon.  A sink has an output order
+   of its own, so one that is slow to take its records does not hold up
+   the output of others.  */
+class log_sink {
+public:
+	log_sink();
+	virtual ~log_sink();
+
+	/* Whether the records are formatted as JSON lines.  */
+	virtual bool json() const = 0;
+
+	/* Called in output order, one at a time, with the record of a file:
+	   its lines for stdout and stderr, or its JSON line as out, and its
+	   outcome, if known.  */
+	virtual void write(std::string const& out, std::string const& err,
+			   char const* outcome) = 0;
+
+private:
+	friend uint64_t log_reserve(log_sink* sink);
+	friend void log_end();
+
+	// Shared, since log_end() still holds it after the last write().
+	std::shared_ptr<log_order> order;
+};
+
+/* Write what would go to stdout to stream instead, for modes in which
+   stdout carries data.  Call before anything is logged.  */
+void log_set_output(FILE* stream);
+
+/* How far positions may be reserved past the first record not yet
+   written, so that the records finished behind a slow file do not pile
+   up in memory.  */
+#define LOG_ORDER_WINDOW 8192
+
+/* Reserve the next position in the output order of sink, or of stdout
+   and stderr if nullptr.  Each position must be passed to log_begin()
+   with the same sink exactly once, or output stops at it.  Threads
+   outside the worker pool block while the position is LOG_ORDER_WINDOW
+   or more past the first record not yet written, so they must not hold
+   back nearly that many positions before handing them to the pool.  */
+uint64_t log_reserve(log_sink* sink = nullptr);
+
+/* Collect the messages of the calling thread for file_name, which was
+   given position seq, until log_end().  They go to sink if given.  */
+void log_begin(uint64_t seq, char const* file_name, log_sink* sink = nullptr);
+
+/* Whether the messages of the current file are formatted as JSON.  */
+bool log_json();
+
+/* Queue the collected messages for output in order.  */
+void log_end();
+
+/* Record the changes made to the current file.  */
+void log_changes(char const* file_name, elfcleaner::result const& res);
+
+/* Record how processing the current file ended.  */
+void log_outcome(stats_outcome outcome);
+
+/* Record a line for stdout in text format; left out of JSON, which
+   has the same information in its fields.  */
+void log_info(char const* format, ...) __attribute__((format(printf, 1, 2)));
+
+/* Record an error, formatted like the line printed in text format.  */
+void log_error(char const* format, ...) __attribute__((format(printf, 1, 2)));
+
+/* log_error() of "s: " and the message for errno, like perror().  */
+void log_perror(char const* s);
+
+#endif
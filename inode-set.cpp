@@ -0,0 +1,41 @@
+/* termux-elf-cleaner
+
+Copyright (C) 2026 Termux
+
+This file is part of termux-elf-cleaner.
+
+termux-elf-cleaner is free software: you can redistribute it and/or
+modify it under the terms of the GNU General Public License as
+published by the Free Software Foundation, either version 3 of the
+License, or (at your option) any later version.
+
+termux-elf-cleaner is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with termux-elf-cleaner.  If not, see
+<https://www.gnu.org/licenses/>.  */
+
+#include "inode-set.h"
+
+size_t inode_set::key_hash::operator()(key const& k) const
+{
+	// Inode numbers are mostly sequential; mix them so shards and
+	// buckets fill evenly.
+	uint64_t h = ((uint64_t) k.dev * 0x9e3779b97f4a7c15ULL) ^ (uint64_t) k.ino;
+	h ^= h >> 33;
+	h *= 0xff51afd7ed558ccdULL;
+	h ^= h >> 33;
+	return h;
+}
+
+bool inode_set::insert(dev_t dev, ino_t ino)
+{
+	key const k = {dev, ino};
+	size_t const h = key_hash()(k);
+	shard& s = shards[h % SHARD_COUNT];
+	std::lock_guard<std::mutex> guard(s.lock);
+	return s.keys.insert(k).second;
+}
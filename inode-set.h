@@ -0,0 +1,61 @@
+/* termux-elf-cleaner
+
+Copyright (C) 2026 Termux
+
+This file is part of termux-elf-cleaner.
+
+termux-elf-cleaner is free software: you can redistribute it and/or
+modify it under the terms of the GNU General Public License as
+published by the Free Software Foundation, either version 3 of the
+License, or (at your option) any later version.
+
+termux-elf-cleaner is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with termux-elf-cleaner.  If not, see
+<https://www.gnu.org/licenses/>.  */
+
+#ifndef ELF_CLEANER_INODE_SET_H
+#define ELF_CLEANER_INODE_SET_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <sys/types.h>
+
+#include <mutex>
+#include <unordered_set>
+
+/* The files seen in a run, by device and inode, so that a file reached
+   through several names, by hard links, symbolic links or by being
+   given twice, is only processed once.  The set is split into shards,
+   each with its own lock, so that workers rarely wait for each other.  */
+class inode_set {
+public:
+	/* Add the file; returns false if it was already in the set.  */
+	bool insert(dev_t dev, ino_t ino);
+
+private:
+	struct key {
+		dev_t dev;
+		ino_t ino;
+
+		bool operator==(key const&) const = default;
+	};
+
+	struct key_hash {
+		size_t operator()(key const& k) const;
+	};
+
+	struct alignas(64) shard {
+		std::mutex lock;
+		std::unordered_set<key, key_hash> keys;
+	};
+
+	static constexpr size_t SHARD_COUNT = 64;
+	shard shards[SHARD_COUNT];
+};
+
+#endif
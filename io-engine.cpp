@@ -0,0 +1,177 @@
+/* termux-elf-cleaner
+
+Copyright (C) 2026 Termux
+
+This file is part of termux-elf-cleaner.
+
+termux-elf-cleaner is free software: you can redistribute it and/or
+modify it under the terms of the GNU General Public License as
+published by the Free Software Foundation, either version 3 of the
+License, or (at your option) any later version.
+
+termux-elf-cleaner is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with termux-elf-cleaner.  If not, see
+<https://www.gnu.org/licenses/>.  */
+
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE
+#endif
+
+#include <errno.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <memory>
+
+#include "io-engine.h"
+
+/* Size of the blocks the per-thread read buffer is carved from.  Ranges
+   larger than this get a block of their own.  */
+#define ARENA_BLOCK_SIZE (64 * 1024)
+
+/* Blocks beyond this total are freed once the buffer is empty again, so
+   one huge section header table does not pin memory for the whole run.  */
+#define ARENA_RETAIN_SIZE (1024 * 1024)
+
+namespace {
+
+/* A stack of buffers.  Allocations stay valid until the arena is
+   released back to a mark taken before them.  */
+class buffer_arena {
+public:
+	struct mark {
+		size_t block;
+		size_t used;
+	};
+
+	mark position() const { return {current, used}; }
+
+	uint8_t* allocate(size_t length)
+	{
+		length = (length + 15) & ~size_t(15);
+		while (current < blocks.size()) {
+			if (blocks[current].size - used >= length) {
+				uint8_t* p = blocks[current].data.get() + used;
+				used += length;
+				return p;
+			}
+			current++;
+			used = 0;
+		}
+		size_t const size = std::max(length, size_t(ARENA_BLOCK_SIZE));
+		blocks.push_back({std::unique_ptr<uint8_t[]>(new uint8_t[size]), size});
+		current = blocks.size() - 1;
+		used = length;
+		return blocks[current].data.get();
+	}
+
+	void release(mark m)
+	{
+		current = m.block;
+		used = m.used;
+		if (current == 0 && used == 0) {
+			size_t total = 0;
+			for (size_t i = 0; i < blocks.size(); i++) {
+				total += blocks[i].size;
+				if (total > ARENA_RETAIN_SIZE) {
+					blocks.resize(i);
+					break;
+				}
+			}
+		}
+	}
+
+private:
+	struct block {
+		std::unique_ptr<uint8_t[]> data;
+		size_t size;
+	};
+
+	std::vector<block> blocks;
+	size_t current = 0;
+	size_t used = 0;
+};
+
+thread_local buffer_arena arena;
+thread_local std::vector<buffer_arena::mark> arena_marks;
+
+}
+
+bool pread_fully(int fd, void* buffer, size_t length, off_t offset)
+{
+	uint8_t* p = static_cast<uint8_t*>(buffer);
+	while (length > 0) {
+		ssize_t n = pread(fd, p, length, offset);
+		if (n < 0) {
+			if (errno == EINTR)
+				continue;
+			return false;
+		}
+		if (n == 0) {
+			errno = EIO;
+			return false;
+		}
+		p += n;
+		length -= n;
+		offset += n;
+	}
+	return true;
+}
+
+bool pwrite_fully(int fd, void const* buffer, size_t length, off_t offset)
+{
+	uint8_t const* p = static_cast<uint8_t const*>(buffer);
+	while (length > 0) {
+		ssize_t n = pwrite(fd, p, length, offset);
+		if (n < 0) {
+			if (errno == EINTR)
+				continue;
+			return false;
+		}
+		p += n;
+		length -= n;
+		offset += n;
+	}
+	return true;
+}
+
+pread_image::pread_image(int fd, size_t size)
+	: image(size), fd(fd)
+{
+	arena_marks.push_back(arena.position());
+}
+
+pread_image::~pread_image()
+{
+	arena.release(arena_marks.back());
+	arena_marks.pop_back();
+}
+
+uint8_t* pread_image::load(size_t offset, size_t length)
+{
+	for (auto const& r : loaded)
+		if (offset >= r.offset && offset + length <= r.offset + r.length)
+			return r.data + (offset - r.offset);
+
+	uint8_t* data = arena.allocate(length);
+	if (!pread_fully(fd, data, length, offset))
+		return nullptr;
+	loaded.push_back({offset, length, data});
+	loaded_bytes += length;
+	return data;
+}
+
+void pread_image::modify(uint8_t* p, size_t length)
+{
+	for (auto const& r : loaded) {
+		if (p >= r.data && p + length <= r.data + r.length) {
+			mark_dirty(r.offset + (p - r.data), length, p);
+			return;
+		}
+	}
+}
@@ -0,0 +1,62 @@
+/* termux-elf-cleaner
+
+Copyright (C) 2026 Termux
+
+This file is part of termux-elf-cleaner.
+
+termux-elf-cleaner is free software: you can redistribute it and/or
+modify it under the terms of the GNU General Public License as
+published by the Free Software Foundation, either version 3 of the
+License, or (at your option) any later version.
+
+termux-elf-cleaner is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with termux-elf-cleaner.  If not, see
+<https://www.gnu.org/licenses/>.  */
+
+#ifndef ELF_CLEANER_IO_ENGINE_H
+#define ELF_CLEANER_IO_ENGINE_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <sys/types.h>
+
+#include <vector>
+
+#include "elfcleaner.h"
+
+/* An image that pread()s only the loaded ranges into a buffer reused by
+   every image created on the same thread.  */
+class pread_image : public elfcleaner::image {
+public:
+	pread_image(int fd, size_t size);
+	~pread_image();
+
+	uint8_t* load(size_t offset, size_t length) override;
+	void modify(uint8_t* p, size_t length) override;
+
+	/* Bytes read from the file so far.  */
+	size_t loaded_size() const { return loaded_bytes; }
+
+private:
+	struct range {
+		size_t offset;
+		size_t length;
+		uint8_t* data;
+	};
+
+	int const fd;
+	std::vector<range> loaded;
+	size_t loaded_bytes = 0;
+};
+
+/* Read or write exactly length bytes at offset, retrying short
+   transfers.  Return false and set errno on failure or early EOF.  */
+bool pread_fully(int fd, void* buffer, size_t length, off_t offset);
+bool pwrite_fully(int fd, void const* buffer, size_t length, off_t offset);
+
+#endif
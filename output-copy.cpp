@@ -0,0 +1,205 @@
+/* termux-elf-cleaner
+
+Copyright (C) 2026 Termux
+
+This file is part of termux-elf-cleaner.
+
+termux-elf-cleaner is free software: you can redistribute it and/or
+modify it under the terms of the GNU General Public License as
+published by the Free Software Foundation, either version 3 of the
+License, or (at your option) any later version.
+
+termux-elf-cleaner is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with termux-elf-cleaner.  If not, see
+<https://www.gnu.org/licenses/>.  */
+
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE
+#endif
+
+#include <errno.h>
+#include <fcntl.h>
+#include <linux/fs.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/ioctl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <atomic>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "elf-cleaner.h"
+#include "file-log.h"
+#include "io-engine.h"
+#include "output-copy.h"
+
+/* Buffer for copying with pread() and pwrite().  */
+#define COPY_BUFFER_SIZE (64 * 1024)
+
+bool output_copy_path(char const* file_name, char const* dir, char const* suffix,
+		      std::string& path)
+{
+	if (dir == NULL) {
+		path = file_name;
+	} else {
+		// Leading slashes and "." components are dropped, so absolute
+		// and relative names alike end up below dir.
+		path = dir;
+		std::string_view rest(file_name);
+		while (!rest.empty()) {
+			size_t const end = std::min(rest.find('/'), rest.size());
+			std::string_view const component = rest.substr(0, end);
+			rest.remove_prefix(std::min(end + 1, rest.size()));
+			if (component.empty() || component == ".")
+				continue;
+			if (component == "..") {
+				log_error("%s: '%s' cannot be placed below '%s'",
+					  PACKAGE_NAME, file_name, dir);
+				return false;
+			}
+			path += '/';
+			path += component;
+		}
+	}
+	if (suffix != NULL)
+		path += suffix;
+	return true;
+}
+
+static bool make_parents(std::string const& path)
+{
+	for (size_t slash = path.find('/', 1); slash != std::string::npos;
+	     slash = path.find('/', slash + 1)) {
+		std::string const dir = path.substr(0, slash);
+		if (mkdir(dir.c_str(), 0777) != 0 && errno != EEXIST) {
+			perror_path("mkdir", dir.c_str());
+			return false;
+		}
+	}
+	return true;
+}
+
+/* Fill out_fd with the size bytes of in_fd.  */
+static bool copy_contents(int in_fd, int out_fd, off_t size, uint64_t& copied)
+{
+	copied = 0;
+	if (ioctl(out_fd, FICLONE, in_fd) == 0)
+		return true;
+
+	bool copy_range = true;
+	std::vector<char> buffer;
+	off_t offset = 0;
+	while (offset < size) {
+		ssize_t n;
+		if (copy_range) {
+			loff_t in_offset = offset;
+			loff_t out_offset = offset;
+			n = copy_file_range(in_fd, &in_offset, out_fd, &out_offset,
+					    size - offset, 0);
+			if (n < 0 && (errno == EXDEV || errno == EINVAL ||
+				      errno == ENOSYS || errno == EOPNOTSUPP)) {
+				copy_range = false;
+				continue;
+			}
+		} else {
+			buffer.resize(COPY_BUFFER_SIZE);
+			n = pread(in_fd, buffer.data(), std::min<off_t>(buffer.size(), size - offset),
+				  offset);
+			if (n > 0 && !pwrite_fully(out_fd, buffer.data(), n, offset))
+				return false;
+		}
+		if (n < 0 && errno == EINTR)
+			continue;
+		if (n <= 0) {
+			// The file was cut short under us.
+			if (n == 0)
+				errno = EIO;
+			return false;
+		}
+		offset += n;
+		copied += n;
+	}
+	return true;
+}
+
+bool create_output_copy(int in_fd, off_t size, mode_t mode, output_copy& copy,
+			uint64_t& copied)
+{
+	if (!make_parents(copy.path))
+		return false;
+	size_t const slash = copy.path.rfind('/');
+	std::string const dir = slash == std::string::npos ? "." :
+		slash == 0 ? "/" : copy.path.substr(0, slash);
+
+	copy.fd = open(dir.c_str(), O_TMPFILE | O_RDWR | O_CLOEXEC, 0600);
+	if (copy.fd < 0 && (errno == EOPNOTSUPP || errno == EISDIR || errno == EINVAL)) {
+		// No unnamed files here; use a named one until it is done.
+		copy.temp_path = copy.path + ".XXXXXX";
+		copy.fd = mkostemp(copy.temp_path.data(), O_CLOEXEC);
+		if (copy.fd < 0) {
+			perror_path("mkostemp", copy.temp_path.c_str());
+			copy.temp_path.clear();
+			return false;
+		}
+	} else if (copy.fd < 0) {
+		perror_path("open", dir.c_str());
+		return false;
+	}
+
+	if (fchmod(copy.fd, mode & 07777) != 0) {
+		perror_path("fchmod", copy.path.c_str());
+		discard_output_copy(copy);
+		return false;
+	}
+	if (!copy_contents(in_fd, copy.fd, size, copied)) {
+		perror_path("copy_file_range", copy.path.c_str());
+		discard_output_copy(copy);
+		return false;
+	}
+	return true;
+}
+
+bool publish_output_copy(output_copy& copy)
+{
+	if (copy.temp_path.empty()) {
+		// linkat() does not replace an existing file, so the copy is
+		// linked under a name of its own and renamed over the target.
+		static std::atomic<unsigned long> next_temp{0};
+		char proc_path[32];
+		snprintf(proc_path, sizeof(proc_path), "/proc/self/fd/%d", copy.fd);
+		std::string const temp_path = copy.path + ".tmp." + std::to_string(getpid()) +
+			"." + std::to_string(next_temp.fetch_add(1));
+		if (linkat(AT_FDCWD, proc_path, AT_FDCWD, temp_path.c_str(), AT_SYMLINK_FOLLOW) != 0) {
+			perror_path("linkat", temp_path.c_str());
+			return false;
+		}
+		copy.temp_path = temp_path;
+	}
+	if (rename(copy.temp_path.c_str(), copy.path.c_str()) != 0) {
+		perror_path("rename", copy.path.c_str());
+		return false;
+	}
+	copy.temp_path.clear();
+	return true;
+}
+
+void discard_output_copy(output_copy& copy)
+{
+	if (!copy.temp_path.empty()) {
+		unlink(copy.temp_path.c_str());
+		copy.temp_path.clear();
+	}
+	if (copy.fd >= 0) {
+		close(copy.fd);
+		copy.fd = -1;
+	}
+}
@@ -0,0 +1,63 @@
+/* termux-elf-cleaner
+
+Copyright (C) 2026 Termux
+
+This file is part of termux-elf-cleaner.
+
+termux-elf-cleaner is free software: you can redistribute it and/or
+modify it under the terms of the GNU General Public License as
+published by the Free Software Foundation, either version 3 of the
+License, or (at your option) any later version.
+
+termux-elf-cleaner is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with termux-elf-cleaner.  If not, see
+<https://www.gnu.org/licenses/>.  */
+
+#ifndef ELF_CLEANER_OUTPUT_COPY_H
+#define ELF_CLEANER_OUTPUT_COPY_H
+
+#include <stdint.h>
+#include <sys/types.h>
+
+#include <string>
+
+/* A cleaned copy of a file, written next to where it is published so
+   that it appears there whole or not at all.  */
+struct output_copy {
+	/* Where the copy is published.  */
+	std::string path;
+	/* The name of the copy until then, if unnamed files could not be
+	   created in the directory.  */
+	std::string temp_path;
+	int fd = -1;
+};
+
+/* Set path to where the copy of file_name goes: below dir, if given,
+   under the same relative path, with suffix appended.  Returns false
+   after logging an error if file_name cannot be placed below dir.  */
+bool output_copy_path(char const* file_name, char const* dir, char const* suffix,
+		      std::string& path);
+
+/* Create the parent directories of copy.path and in it a copy of the
+   size bytes of the file open as in_fd, with mode.  The copy shares the
+   extents of the file with FICLONE where the file system can, and is
+   copied with copy_file_range() otherwise.  copied receives the number
+   of bytes that had to be copied.  Returns false after logging an
+   error, with nothing left behind.  */
+bool create_output_copy(int in_fd, off_t size, mode_t mode, output_copy& copy,
+			uint64_t& copied);
+
+/* Give the copy its name, replacing any file there.  Returns false
+   after logging an error.  Leaves the descriptor open.  */
+bool publish_output_copy(output_copy& copy);
+
+/* Remove what is left of a copy that is not to be published, and close
+   it.  */
+void discard_output_copy(output_copy& copy);
+
+#endif
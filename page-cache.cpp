@@ -0,0 +1,106 @@
+/* termux-elf-cleaner
+
+Copyright (C) 2026 Termux
+
+This file is part of termux-elf-cleaner.
+
+termux-elf-cleaner is free software: you can redistribute it and/or
+modify it under the terms of the GNU General Public License as
+published by the Free Software Foundation, either version 3 of the
+License, or (at your option) any later version.
+
+termux-elf-cleaner is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with termux-elf-cleaner.  If not, see
+<https://www.gnu.org/licenses/>.  */
+
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE
+#endif
+
+#include <errno.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/uio.h>
+#include <unistd.h>
+
+#include "io-engine.h"
+#include "page-cache.h"
+
+static size_t page_size()
+{
+	static size_t const size = sysconf(_SC_PAGESIZE);
+	return size;
+}
+
+void cache_residency::record(void* mem, size_t size)
+{
+	size_t const pages = (size + page_size() - 1) / page_size();
+	resident.assign(pages, 0);
+	// When it cannot be told, everything is kept.
+	if (mincore(mem, size, resident.data()) != 0)
+		resident.assign(pages, 1);
+	if (pages > 0)
+		resident[0] = first_page_cached;
+}
+
+void cache_residency::record(int fd, size_t size)
+{
+	void* mem = mmap(0, size, PROT_READ, MAP_SHARED, fd, 0);
+	if (mem == MAP_FAILED) {
+		resident.assign((size + page_size() - 1) / page_size(), 1);
+		return;
+	}
+	record(mem, size);
+	munmap(mem, size);
+}
+
+void cache_residency::evict(int fd) const
+{
+	if (resident.empty()) {
+		if (!first_page_cached)
+			posix_fadvise(fd, 0, page_size(), POSIX_FADV_DONTNEED);
+		return;
+	}
+	// Only the low bit tells whether a page is resident.
+	for (size_t i = 0; i < resident.size();) {
+		if (resident[i] & 1) {
+			i++;
+			continue;
+		}
+		size_t const start = i;
+		while (i < resident.size() && !(resident[i] & 1))
+			i++;
+		posix_fadvise(fd, start * page_size(), (i - start) * page_size(),
+			      POSIX_FADV_DONTNEED);
+	}
+}
+
+uint8_t* prefetch_image::load(size_t offset, size_t length)
+{
+	uintptr_t const start = reinterpret_cast<uintptr_t>(bytes + offset) & ~(page_size() - 1);
+	uintptr_t const end = reinterpret_cast<uintptr_t>(bytes + offset + length);
+	if (length > 0)
+		madvise(reinterpret_cast<void*>(start), end - start, MADV_WILLNEED);
+	return buffer_image::load(offset, length);
+}
+
+bool pread_cached(int fd, void* buffer, size_t length, bool& cached)
+{
+	// RWF_NOWAIT reads only from the page cache, failing with EAGAIN
+	// where that would mean waiting for the disk.
+	struct iovec iov = {buffer, length};
+	ssize_t const n = preadv2(fd, &iov, 1, 0, RWF_NOWAIT);
+	if (n == (ssize_t) length) {
+		cached = true;
+		return true;
+	}
+	// Where the file system cannot tell, take the bytes as cached, so
+	// that they are not dropped for someone else.
+	cached = n < 0 && errno != EAGAIN;
+	return pread_fully(fd, buffer, length, 0);
+}
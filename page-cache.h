@@ -0,0 +1,76 @@
+/* termux-elf-cleaner
+
+Copyright (C) 2026 Termux
+
+This file is part of termux-elf-cleaner.
+
+termux-elf-cleaner is free software: you can redistribute it and/or
+modify it under the terms of the GNU General Public License as
+published by the Free Software Foundation, either version 3 of the
+License, or (at your option) any later version.
+
+termux-elf-cleaner is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with termux-elf-cleaner.  If not, see
+<https://www.gnu.org/licenses/>.  */
+
+#ifndef ELF_CLEANER_PAGE_CACHE_H
+#define ELF_CLEANER_PAGE_CACHE_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <sys/types.h>
+
+#include <vector>
+
+#include "elfcleaner.h"
+
+/* Which pages of a file were in the page cache before it was read, so
+   that the others can be dropped again once done with it, and a run over
+   a large tree does not push the rest of the system out of the cache.  */
+class cache_residency {
+public:
+	/* first_page_cached tells whether the first page of the file was
+	   in the page cache before its identification was read.  */
+	explicit cache_residency(bool first_page_cached)
+		: first_page_cached(first_page_cached) {}
+
+	/* Record which of the size bytes mapped at mem, none of which have
+	   been accessed yet, are in the page cache.  */
+	void record(void* mem, size_t size);
+
+	/* Like record(), for the first size bytes of fd, which are mapped
+	   only to look.  */
+	void record(int fd, size_t size);
+
+	/* Drop the pages of fd that were not in the page cache before.  */
+	void evict(int fd) const;
+
+private:
+	bool const first_page_cached;
+	std::vector<unsigned char> resident;
+};
+
+/* A buffer_image of a mapping advised MADV_RANDOM, which asks for each
+   range before it is loaded, so that a range spanning several pages is
+   read in one go instead of a page per fault.  */
+class prefetch_image : public elfcleaner::buffer_image {
+public:
+	explicit prefetch_image(std::span<uint8_t> bytes)
+		: buffer_image(bytes), bytes(bytes.data()) {}
+
+	uint8_t* load(size_t offset, size_t length) override;
+
+private:
+	uint8_t* const bytes;
+};
+
+/* Read length bytes at the start of fd, like pread_fully(), and tell in
+   cached whether they were in the page cache already.  */
+bool pread_cached(int fd, void* buffer, size_t length, bool& cached);
+
+#endif
@@ -0,0 +1,180 @@
+/* termux-elf-cleaner
+
+Copyright (C) 2026 Termux
+
+This file is part of termux-elf-cleaner.
+
+termux-elf-cleaner is free software: you can redistribute it and/or
+modify it under the terms of the GNU General Public License as
+published by the Free Software Foundation, either version 3 of the
+License, or (at your option) any later version.
+
+termux-elf-cleaner is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with termux-elf-cleaner.  If not, see
+<https://www.gnu.org/licenses/>.  */
+
+#include <errno.h>
+#include <stdio.h>
+#include <string.h>
+
+#include <algorithm>
+#include <string>
+#include <vector>
+
+#include "elf-cleaner.h"
+#include "patch-manifest.h"
+
+namespace {
+
+void put(std::string& out, uint64_t value, int size)
+{
+	for (int i = 0; i < size; i++)
+		out += (char) (value >> (8 * i));
+}
+
+/* Reads the fields of a manifest held in memory, failing on any read
+   past its end.  */
+class manifest_reader {
+public:
+	explicit manifest_reader(std::string const& data) : data(data) {}
+
+	bool ok() const { return good; }
+	bool at_end() const { return pos == data.size(); }
+
+	uint64_t number(int size)
+	{
+		if (!have(size))
+			return 0;
+		uint64_t value = 0;
+		for (int i = 0; i < size; i++)
+			value |= (uint64_t) (uint8_t) data[pos + i] << (8 * i);
+		pos += size;
+		return value;
+	}
+
+	void bytes(void* out, size_t length)
+	{
+		if (!have(length))
+			return;
+		memcpy(out, data.data() + pos, length);
+		pos += length;
+	}
+
+private:
+	bool have(size_t length)
+	{
+		if (good && data.size() - pos < length)
+			good = false;
+		return good;
+	}
+
+	std::string const& data;
+	size_t pos = 0;
+	bool good = true;
+};
+
+}
+
+bool write_patch_manifest(char const* path, std::vector<file_patch>& patches)
+{
+	std::sort(patches.begin(), patches.end(),
+		  [](file_patch const& a, file_patch const& b) { return a.name < b.name; });
+
+	std::string out(PATCH_MAGIC, PATCH_MAGIC_SIZE);
+	put(out, PATCH_VERSION, 4);
+	for (file_patch const& patch : patches) {
+		put(out, patch.name.size(), 4);
+		out += patch.name;
+		put(out, patch.size, 8);
+		put(out, patch.ranges.size(), 4);
+		for (patch_range const& range : patch.ranges) {
+			put(out, range.offset, 8);
+			put(out, range.old_bytes.size(), 4);
+			out.append(range.old_bytes.begin(), range.old_bytes.end());
+			out.append(range.new_bytes.begin(), range.new_bytes.end());
+		}
+	}
+
+	FILE* stream = fopen(path, "wb");
+	if (stream == NULL) {
+		perror_path("fopen", path);
+		return false;
+	}
+	bool ok = fwrite(out.data(), 1, out.size(), stream) == out.size();
+	if (!ok)
+		perror_path("fwrite", path);
+	if (fclose(stream) != 0 && ok) {
+		perror_path("fclose", path);
+		ok = false;
+	}
+	return ok;
+}
+
+bool read_patch_manifest(char const* path, std::vector<file_patch>& patches)
+{
+	FILE* stream = fopen(path, "rb");
+	if (stream == NULL) {
+		perror_path("fopen", path);
+		return false;
+	}
+	std::string data;
+	char buffer[65536];
+	size_t n;
+	while ((n = fread(buffer, 1, sizeof(buffer), stream)) > 0)
+		data.append(buffer, n);
+	bool const read_error = ferror(stream);
+	fclose(stream);
+	if (read_error) {
+		perror_path("fread", path);
+		return false;
+	}
+
+	manifest_reader in(data);
+	char magic[PATCH_MAGIC_SIZE] = {};
+	in.bytes(magic, PATCH_MAGIC_SIZE);
+	uint64_t const version = in.number(4);
+	if (!in.ok() || memcmp(magic, PATCH_MAGIC, PATCH_MAGIC_SIZE) != 0 ||
+	    version != PATCH_VERSION) {
+		fprintf(stderr, "%s: '%s' is not a patch manifest of version %d\n",
+			PACKAGE_NAME, path, PATCH_VERSION);
+		return false;
+	}
+	while (in.ok() && !in.at_end()) {
+		file_patch patch;
+		uint64_t const name_length = in.number(4);
+		if (name_length > data.size())
+			break;
+		patch.name.resize(name_length);
+		in.bytes(patch.name.data(), name_length);
+		patch.size = in.number(8);
+		uint64_t const count = in.number(4);
+		for (uint64_t i = 0; in.ok() && i < count; i++) {
+			patch_range range;
+			range.offset = in.number(8);
+			uint64_t const length = in.number(4);
+			// Checked against what is left before anything is allocated.
+			if (!in.ok() || length > data.size())
+				break;
+			range.old_bytes.resize(length);
+			range.new_bytes.resize(length);
+			in.bytes(range.old_bytes.data(), length);
+			in.bytes(range.new_bytes.data(), length);
+			patch.ranges.push_back(std::move(range));
+		}
+		if (in.ok() && patch.ranges.size() == count)
+			patches.push_back(std::move(patch));
+		else
+			break;
+	}
+	if (!in.ok() || !in.at_end()) {
+		fprintf(stderr, "%s: Patch manifest '%s' is truncated or damaged\n",
+			PACKAGE_NAME, path);
+		return false;
+	}
+	return true;
+}
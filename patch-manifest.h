@@ -0,0 +1,61 @@
+/* termux-elf-cleaner
+
+Copyright (C) 2026 Termux
+
+This file is part of termux-elf-cleaner.
+
+termux-elf-cleaner is free software: you can redistribute it and/or
+modify it under the terms of the GNU General Public License as
+published by the Free Software Foundation, either version 3 of the
+License, or (at your option) any later version.
+
+termux-elf-cleaner is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with termux-elf-cleaner.  If not, see
+<https://www.gnu.org/licenses/>.  */
+
+#ifndef ELF_CLEANER_PATCH_MANIFEST_H
+#define ELF_CLEANER_PATCH_MANIFEST_H
+
+#include <stdint.h>
+
+#include <string>
+#include <vector>
+
+/* A manifest starts with PATCH_MAGIC and the version as a 32-bit
+   number.  Then, for each file: the length of its name as a 32-bit
+   number and the name, its size as a 64-bit number, the number of
+   changed ranges as a 32-bit number and, for each range, its offset as
+   a 64-bit and its length as a 32-bit number, followed by that many
+   old bytes and then as many new bytes.  Numbers are little-endian.  */
+#define PATCH_MAGIC "TECPATCH"
+#define PATCH_MAGIC_SIZE 8
+#define PATCH_VERSION 1
+
+struct patch_range {
+	uint64_t offset;
+	std::vector<uint8_t> old_bytes;
+	std::vector<uint8_t> new_bytes;
+};
+
+/* The changes to make to one file, by the name it was cleaned under.  */
+struct file_patch {
+	std::string name;
+	uint64_t size;
+	std::vector<patch_range> ranges;
+};
+
+/* Write patches to the manifest at path, sorted by name, so that runs
+   over the same files give the same manifest.  Returns false after
+   printing an error.  */
+bool write_patch_manifest(char const* path, std::vector<file_patch>& patches);
+
+/* Read the manifest at path into patches.  Returns false after printing
+   an error if it cannot be read or is not a valid manifest.  */
+bool read_patch_manifest(char const* path, std::vector<file_patch>& patches);
+
+#endif
@@ -0,0 +1,330 @@
+/* termux-elf-cleaner
+
+Copyright (C) 2026 Termux
+
+This file is part of termux-elf-cleaner.
+
+termux-elf-cleaner is free software: you can redistribute it and/or
+modify it under the terms of the GNU General Public License as
+published by the Free Software Foundation, either version 3 of the
+License, or (at your option) any later version.
+
+termux-elf-cleaner is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with termux-elf-cleaner.  If not, see
+<https://www.gnu.org/licenses/>.  */
+
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE
+#endif
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/file.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/xattr.h>
+#include <unistd.h>
+
+#include <string>
+
+#include "elf-cleaner.h"
+#include "file-log.h"
+#include "skip-cache.h"
+
+#define INDEX_MAGIC "TECSKIP"
+#define INDEX_VERSION 1
+
+/* Slots in a new index.  The table doubles when it gets half full, up
+   to INDEX_MAX_SLOTS, after which it starts over empty.  */
+#define INDEX_MIN_SLOTS (1 << 16)
+#define INDEX_MAX_SLOTS (1 << 24)
+
+/* Give up inserting or looking up a key after this many slots.  */
+#define INDEX_MAX_PROBES 32
+
+#define XATTR_NAME "user.termux-elf-cleaner"
+
+static uint64_t mix(uint64_t hash, uint64_t value)
+{
+	// splitmix64 finalizer over the running hash.
+	hash ^= value + 0x9e3779b97f4a7c15ULL + (hash << 6) + (hash >> 2);
+	hash ^= hash >> 30;
+	hash *= 0xbf58476d1ce4e5b9ULL;
+	hash ^= hash >> 27;
+	hash *= 0x94d049bb133111ebULL;
+	hash ^= hash >> 31;
+	return hash;
+}
+
+uint64_t skip_cache::key(struct stat const& st, elfcleaner::options const& opts,
+			 bool with_inode)
+{
+	uint64_t hash = mix(0, elfcleaner::ruleset_version);
+	hash = mix(hash, opts.api_level);
+	hash = mix(hash, opts.supported_dt_flags_1);
+	if (with_inode) {
+		hash = mix(hash, st.st_dev);
+		hash = mix(hash, st.st_ino);
+	}
+	hash = mix(hash, st.st_size);
+	hash = mix(hash, st.st_mtim.tv_sec);
+	hash = mix(hash, st.st_mtim.tv_nsec);
+	return hash != 0 ? hash : 1;
+}
+
+bool skip_cache::lookup(char const* path, struct stat const& st,
+			elfcleaner::options const& opts)
+{
+	bool const found = contains(path, st, opts);
+	(found ? hits : misses).fetch_add(1, std::memory_order_relaxed);
+	return found;
+}
+
+namespace {
+
+struct index_header {
+	char magic[8];
+	uint32_t version;
+	uint32_t reserved;
+	uint64_t slot_count;
+	uint64_t used_count;
+};
+
+class index_skip_cache : public skip_cache {
+public:
+	index_skip_cache(void* mem, size_t size)
+		: mem(mem), size(size),
+		  header(static_cast<index_header*>(mem)),
+		  slots(reinterpret_cast<uint64_t*>(header + 1)),
+		  mask(header->slot_count - 1) {}
+
+	~index_skip_cache() { munmap(mem, size); }
+
+	void insert(char const*, struct stat const& st,
+		    elfcleaner::options const& opts) override
+	{
+		uint64_t const k = key(st, opts, true);
+		for (uint64_t i = 0; i < INDEX_MAX_PROBES; i++) {
+			std::atomic_ref<uint64_t> slot(slots[(k + i) & mask]);
+			uint64_t expected = 0;
+			if (slot.compare_exchange_strong(expected, k)) {
+				std::atomic_ref<uint64_t>(header->used_count).fetch_add(1);
+				return;
+			}
+			if (expected == k)
+				return;
+		}
+	}
+
+protected:
+	bool contains(char const*, struct stat const& st,
+		      elfcleaner::options const& opts) override
+	{
+		uint64_t const k = key(st, opts, true);
+		for (uint64_t i = 0; i < INDEX_MAX_PROBES; i++) {
+			uint64_t const value = std::atomic_ref<uint64_t>(slots[(k + i) & mask]).load();
+			if (value == k)
+				return true;
+			if (value == 0)
+				return false;
+		}
+		return false;
+	}
+
+private:
+	void* const mem;
+	size_t const size;
+	index_header* const header;
+	uint64_t* const slots;
+	uint64_t const mask;
+};
+
+class xattr_skip_cache : public skip_cache {
+public:
+	void insert(char const* path, struct stat const& st,
+		    elfcleaner::options const& opts) override
+	{
+		uint64_t const k = key(st, opts, false);
+		// Failures just mean the file is checked again next time.
+		setxattr(path, XATTR_NAME, &k, sizeof(k), 0);
+	}
+
+protected:
+	bool contains(char const* path, struct stat const& st,
+		      elfcleaner::options const& opts) override
+	{
+		uint64_t stored;
+		if (getxattr(path, XATTR_NAME, &stored, sizeof(stored)) != sizeof(stored))
+			return false;
+		return stored == key(st, opts, false);
+	}
+};
+
+size_t index_size(uint64_t slot_count)
+{
+	return sizeof(index_header) + slot_count * sizeof(uint64_t);
+}
+
+/* Create an empty index with slot_count slots in a new file next to path
+   and return its descriptor, or -1 after printing an error.  The old
+   entries of a too small index are carried over from old_header.  */
+int create_index(char const* path, uint64_t slot_count, index_header const* old_header)
+{
+	// Runs that locked indexes since replaced may create one at the same
+	// time, so each writes a file of its own.
+	std::string temp_path = std::string(path) + ".XXXXXX";
+	int fd = mkostemp(temp_path.data(), O_CLOEXEC);
+	if (fd < 0) {
+		perror_path("mkostemp", temp_path.c_str());
+		return -1;
+	}
+	size_t const size = index_size(slot_count);
+	void* mem = MAP_FAILED;
+	if (fchmod(fd, 0644) < 0)
+		perror_path("fchmod", temp_path.c_str());
+	else if (ftruncate(fd, size) < 0)
+		perror_path("ftruncate", temp_path.c_str());
+	else if ((mem = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0)) == MAP_FAILED)
+		perror_path("mmap", temp_path.c_str());
+	if (mem == MAP_FAILED) {
+		close(fd);
+		unlink(temp_path.c_str());
+		return -1;
+	}
+
+	auto* header = static_cast<index_header*>(mem);
+	memcpy(header->magic, INDEX_MAGIC, sizeof(header->magic));
+	header->version = INDEX_VERSION;
+	header->slot_count = slot_count;
+	if (old_header != NULL && slot_count <= INDEX_MAX_SLOTS) {
+		uint64_t const* old_slots = reinterpret_cast<uint64_t const*>(old_header + 1);
+		uint64_t* slots = reinterpret_cast<uint64_t*>(header + 1);
+		for (uint64_t i = 0; i < old_header->slot_count; i++) {
+			uint64_t const k = old_slots[i];
+			if (k == 0)
+				continue;
+			for (uint64_t j = 0; j < INDEX_MAX_PROBES; j++) {
+				uint64_t& slot = slots[(k + j) & (slot_count - 1)];
+				if (slot == 0) {
+					slot = k;
+					header->used_count++;
+					break;
+				}
+			}
+		}
+	}
+	munmap(mem, size);
+
+	if (rename(temp_path.c_str(), path) < 0) {
+		perror_path("rename", temp_path.c_str());
+		close(fd);
+		unlink(temp_path.c_str());
+		return -1;
+	}
+	return fd;
+}
+
+}
+
+std::unique_ptr<skip_cache> open_index_skip_cache(char const* path)
+{
+	int fd;
+	struct stat st;
+	for (;;) {
+		fd = open(path, O_RDWR | O_CREAT | O_CLOEXEC, 0644);
+		if (fd < 0) {
+			perror_path("open", path);
+			return nullptr;
+		}
+		// Serialize creating and growing the index with other runs.
+		if (flock(fd, LOCK_EX) < 0) {
+			perror_path("flock", path);
+			close(fd);
+			return nullptr;
+		}
+		if (fstat(fd, &st) < 0) {
+			perror_path("fstat", path);
+			close(fd);
+			return nullptr;
+		}
+
+		// Another run may have replaced the index while this one waited
+		// for the lock, in which case the newer one is opened instead.
+		struct stat path_st;
+		if (stat(path, &path_st) == 0) {
+			if (path_st.st_dev == st.st_dev && path_st.st_ino == st.st_ino)
+				break;
+		} else if (errno != ENOENT) {
+			perror_path("stat", path);
+			close(fd);
+			return nullptr;
+		}
+		close(fd);
+	}
+
+	uint64_t new_slot_count = 0;
+	void* old_mem = MAP_FAILED;
+	index_header const* old_header = NULL;
+	if ((size_t) st.st_size < sizeof(index_header)) {
+		new_slot_count = INDEX_MIN_SLOTS;
+	} else {
+		old_mem = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+		if (old_mem == MAP_FAILED) {
+			perror_path("mmap", path);
+			close(fd);
+			return nullptr;
+		}
+		old_header = static_cast<index_header const*>(old_mem);
+		uint64_t const slots = old_header->slot_count;
+		if (memcmp(old_header->magic, INDEX_MAGIC, sizeof(old_header->magic)) != 0 ||
+		    old_header->version != INDEX_VERSION ||
+		    slots < INDEX_MIN_SLOTS || (slots & (slots - 1)) != 0 ||
+		    (size_t) st.st_size != index_size(slots)) {
+			log_error("%s: Ignoring invalid skip cache '%s'",
+				  PACKAGE_NAME, path);
+			new_slot_count = INDEX_MIN_SLOTS;
+			old_header = NULL;
+		} else if (old_header->used_count * 2 > slots) {
+			new_slot_count = slots * 2;
+			if (new_slot_count > INDEX_MAX_SLOTS) {
+				new_slot_count = INDEX_MIN_SLOTS;
+				old_header = NULL;
+			}
+		}
+	}
+
+	if (new_slot_count != 0) {
+		int new_fd = create_index(path, new_slot_count, old_header);
+		if (old_mem != MAP_FAILED)
+			munmap(old_mem, st.st_size);
+		old_mem = MAP_FAILED;
+		close(fd);
+		if (new_fd < 0)
+			return nullptr;
+		fd = new_fd;
+		st.st_size = index_size(new_slot_count);
+	}
+	if (old_mem != MAP_FAILED)
+		munmap(old_mem, st.st_size);
+
+	void* mem = mmap(NULL, st.st_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+	if (mem == MAP_FAILED)
+		perror_path("mmap", path);
+	// Closing drops the lock; the mapping keeps the index alive.
+	close(fd);
+	if (mem == MAP_FAILED)
+		return nullptr;
+	return std::make_unique<index_skip_cache>(mem, st.st_size);
+}
+
+std::unique_ptr<skip_cache> open_xattr_skip_cache()
+{
+	return std::make_unique<xattr_skip_cache>();
+}
@@ -0,0 +1,87 @@
+/* termux-elf-cleaner
+
+Copyright (C) 2026 Termux
+
+This file is part of termux-elf-cleaner.
+
+termux-elf-cleaner is free software: you can redistribute it and/or
+modify it under the terms of the GNU General Public License as
+published by the Free Software Foundation, either version 3 of the
+License, or (at your option) any later version.
+
+termux-elf-cleaner is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with termux-elf-cleaner.  If not, see
+<https://www.gnu.org/licenses/>.  */
+
+#ifndef ELF_CLEANER_SKIP_CACHE_H
+#define ELF_CLEANER_SKIP_CACHE_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <sys/stat.h>
+
+#include <atomic>
+#include <memory>
+
+#include "elfcleaner.h"
+
+/* Remembers files that are known to need no changes under a set of
+   cleaning options, so later runs can skip them after a stat().  A
+   file is identified by its device, inode, size and modification time,
+   so any change to it is a miss.  All methods may be called from several
+   workers at once.  */
+class skip_cache {
+public:
+	virtual ~skip_cache() {}
+
+	/* Whether the file at path, last seen as st, is known to be clean
+	   under opts.  Counts a hit or a miss.  */
+	bool lookup(char const* path, struct stat const& st,
+		    elfcleaner::options const& opts);
+
+	/* Like lookup(), but without counting a hit or a miss.  */
+	bool peek(char const* path, struct stat const& st,
+		  elfcleaner::options const& opts)
+	{
+		return contains(path, st, opts);
+	}
+
+	/* Record that the file at path, as described by st, is clean under
+	   opts.  */
+	virtual void insert(char const* path, struct stat const& st,
+			    elfcleaner::options const& opts) = 0;
+
+	uint64_t hit_count() const { return hits.load(); }
+	uint64_t miss_count() const { return misses.load(); }
+
+protected:
+	virtual bool contains(char const* path, struct stat const& st,
+			      elfcleaner::options const& opts) = 0;
+
+	/* Hash of the file identity together with the cleaning options.  The
+	   device and inode are left out when the key is stored on the inode
+	   itself.  Never 0.  */
+	static uint64_t key(struct stat const& st, elfcleaner::options const& opts,
+			    bool with_inode);
+
+private:
+	std::atomic<uint64_t> hits{0};
+	std::atomic<uint64_t> misses{0};
+};
+
+/* A cache in an open addressing hash table of keys in a file that is
+   mapped shared, so workers, and concurrent runs, insert with atomic
+   compare and swap.  Returns nullptr after printing an error if the file
+   cannot be opened or created.  */
+std::unique_ptr<skip_cache> open_index_skip_cache(char const* path);
+
+/* A cache that stores the key in a user.* extended attribute of each
+   file.  Files on file systems without user xattrs are always misses.  */
+std::unique_ptr<skip_cache> open_xattr_skip_cache();
+
+#endif
@@ -0,0 +1,268 @@
+/* termux-elf-cleaner
+
+Copyright (C) 2026 Termux
+
+This file is part of termux-elf-cleaner.
+
+termux-elf-cleaner is free software: you can redistribute it and/or
+modify it under the terms of the GNU General Public License as
+published by the Free Software Foundation, either version 3 of the
+License, or (at your option) any later version.
+
+termux-elf-cleaner is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with termux-elf-cleaner.  If not, see
+<https://www.gnu.org/licenses/>.  */
+
+#include <string.h>
+#include <time.h>
+
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#include "stats.h"
+#include "worker-pool.h"
+
+namespace {
+
+char const* const phase_names[PHASE_COUNT] = {
+	"open", "stat", "ident", "map", "process", "write", "sync", "close",
+};
+
+char const* const outcome_names[OUTCOME_COUNT] = {
+	"not_elf", "big_endian", "clean", "modified", "error", "skipped",
+	"duplicate",
+};
+
+/* The first four are not dynamic entries; the rest are matched by the
+   DT_* name in the change.  */
+char const* const rule_names[STATS_RULE_COUNT] = {
+	"TLS_ALIGNMENT", "VERDEF", "VERNEED", "VERSYM",
+	"DT_GNU_HASH", "DT_VERSYM", "DT_VERNEED", "DT_VERNEEDNUM",
+	"DT_VERDEF", "DT_VERDEFNUM", "DT_RPATH", "DT_RUNPATH",
+	"DT_AARCH64_BTI_PLT", "DT_AARCH64_PAC_PLT", "DT_AARCH64_VARIANT_PCS",
+	"DF_1_FLAGS",
+};
+
+#define RULE_TLS_ALIGNMENT 0
+#define RULE_DT_FLAGS_1 (STATS_RULE_COUNT - 1)
+
+std::unique_ptr<run_stats[]> slots;
+unsigned int slot_count = 0;
+
+/* Counters of the threads that are not pool workers, such as the main
+   thread, directory walkers and daemon sessions.  A thread takes one on
+   first use and hands it back when it exits, to be reused by the next,
+   so its counts stay in the totals.  */
+std::mutex other_lock;
+std::vector<std::unique_ptr<run_stats>> other_slots;
+std::vector<run_stats*> free_slots;
+
+struct other_slot {
+	run_stats* stats = nullptr;
+
+	~other_slot()
+	{
+		if (stats == nullptr)
+			return;
+		std::lock_guard<std::mutex> guard(other_lock);
+		free_slots.push_back(stats);
+	}
+};
+
+thread_local other_slot own_slot;
+
+int rule_index(elfcleaner::change const& c)
+{
+	using elfcleaner::change_kind;
+
+	switch (c.kind) {
+	case change_kind::tls_alignment:
+		return RULE_TLS_ALIGNMENT;
+	case change_kind::dt_flags_1_replaced:
+		return RULE_DT_FLAGS_1;
+	case change_kind::section_removed:
+	case change_kind::dynamic_entry_removed:
+		for (int i = 1; i < RULE_DT_FLAGS_1; i++)
+			if (strcmp(rule_names[i], c.name) == 0)
+				return i;
+		break;
+	}
+	return -1;
+}
+
+}
+
+char const* stats_outcome_name(stats_outcome outcome)
+{
+	return outcome_names[outcome];
+}
+
+void run_stats::add_changes(elfcleaner::result const& res)
+{
+	for (auto const& c : res.changes) {
+		int const i = rule_index(c);
+		if (i >= 0)
+			rules[i]++;
+	}
+}
+
+void run_stats::add_latency(uint64_t ns)
+{
+	uint64_t const us = ns / 1000;
+	int bucket = us < 2 ? 0 : 63 - __builtin_clzll(us);
+	if (bucket >= STATS_LATENCY_BUCKETS)
+		bucket = STATS_LATENCY_BUCKETS - 1;
+	latency[bucket]++;
+}
+
+void stats_init(unsigned int workers)
+{
+	slot_count = workers;
+	slots.reset(new run_stats[slot_count]());
+}
+
+run_stats* thread_stats()
+{
+	if (!slots)
+		return nullptr;
+	int const worker = worker_pool::current_worker();
+	if (worker >= 0)
+		return &slots[worker];
+	if (own_slot.stats == nullptr) {
+		std::lock_guard<std::mutex> guard(other_lock);
+		if (!free_slots.empty()) {
+			own_slot.stats = free_slots.back();
+			free_slots.pop_back();
+		} else {
+			other_slots.emplace_back(new run_stats());
+			own_slot.stats = other_slots.back().get();
+		}
+	}
+	return own_slot.stats;
+}
+
+uint64_t stats_clock()
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+uint64_t stats_lap(run_stats* stats, stats_phase phase, uint64_t start)
+{
+	if (stats == nullptr)
+		return 0;
+	uint64_t const now = stats_clock();
+	stats->phase_ns[phase] += now - start;
+	return now;
+}
+
+void stats_print(FILE* stream, bool json)
+{
+	std::vector<run_stats const*> all;
+	for (unsigned int s = 0; s < slot_count; s++)
+		all.push_back(&slots[s]);
+	{
+		std::lock_guard<std::mutex> guard(other_lock);
+		for (auto const& other : other_slots)
+			all.push_back(other.get());
+	}
+
+	run_stats total = {};
+	for (run_stats const* slot : all) {
+		run_stats const& st = *slot;
+		for (int i = 0; i < PHASE_COUNT; i++)
+			total.phase_ns[i] += st.phase_ns[i];
+		for (int i = 0; i < OUTCOME_COUNT; i++)
+			total.outcomes[i] += st.outcomes[i];
+		for (int i = 0; i < STATS_RULE_COUNT; i++)
+			total.rules[i] += st.rules[i];
+		for (int i = 0; i < STATS_LATENCY_BUCKETS; i++)
+			total.latency[i] += st.latency[i];
+		total.bytes_mapped += st.bytes_mapped;
+		total.bytes_read += st.bytes_read;
+		total.bytes_written += st.bytes_written;
+		total.ident_rejects += st.ident_rejects;
+		total.minor_faults += st.minor_faults;
+		total.major_faults += st.major_faults;
+	}
+
+	uint64_t files = 0;
+	for (int i = 0; i < OUTCOME_COUNT; i++)
+		files += total.outcomes[i];
+
+	if (json) {
+		fprintf(stream, "{\"files\": %llu, \"ident_rejected\": %llu, \"outcomes\": {",
+			(unsigned long long) files, (unsigned long long) total.ident_rejects);
+		for (int i = 0; i < OUTCOME_COUNT; i++)
+			fprintf(stream, "%s\"%s\": %llu", i ? ", " : "", outcome_names[i],
+				(unsigned long long) total.outcomes[i]);
+		fprintf(stream, "}, \"seconds\": {");
+		for (int i = 0; i < PHASE_COUNT; i++)
+			fprintf(stream, "%s\"%s\": %.6f", i ? ", " : "", phase_names[i],
+				total.phase_ns[i] / 1e9);
+		fprintf(stream, "}, \"bytes\": {\"mapped\": %llu, \"read\": %llu, \"written\": %llu}",
+			(unsigned long long) total.bytes_mapped,
+			(unsigned long long) total.bytes_read,
+			(unsigned long long) total.bytes_written);
+		fprintf(stream, ", \"page_faults\": {\"minor\": %llu, \"major\": %llu}",
+			(unsigned long long) total.minor_faults,
+			(unsigned long long) total.major_faults);
+		fprintf(stream, ", \"rules\": {");
+		for (int i = 0; i < STATS_RULE_COUNT; i++)
+			fprintf(stream, "%s\"%s\": %llu", i ? ", " : "", rule_names[i],
+				(unsigned long long) total.rules[i]);
+		fprintf(stream, "}, \"latency_us\": [");
+		for (int i = 0; i < STATS_LATENCY_BUCKETS; i++) {
+			if (i < STATS_LATENCY_BUCKETS - 1)
+				fprintf(stream, "%s{\"below\": %llu, \"files\": %llu}", i ? ", " : "",
+					1ULL << (i + 1), (unsigned long long) total.latency[i]);
+			else
+				fprintf(stream, ", {\"below\": null, \"files\": %llu}",
+					(unsigned long long) total.latency[i]);
+		}
+		fprintf(stream, "]}\n");
+		return;
+	}
+
+	fprintf(stream, "%s: Statistics for %llu files\n", PACKAGE_NAME,
+		(unsigned long long) files);
+	for (int i = 0; i < OUTCOME_COUNT; i++)
+		fprintf(stream, "  %-24s %12llu\n", outcome_names[i],
+			(unsigned long long) total.outcomes[i]);
+	fprintf(stream, "  %-24s %12llu\n", "rejected from ident",
+		(unsigned long long) total.ident_rejects);
+	fprintf(stream, "Phase seconds\n");
+	for (int i = 0; i < PHASE_COUNT; i++)
+		fprintf(stream, "  %-24s %12.6f\n", phase_names[i], total.phase_ns[i] / 1e9);
+	fprintf(stream, "Bytes\n");
+	fprintf(stream, "  %-24s %12llu\n", "mapped", (unsigned long long) total.bytes_mapped);
+	fprintf(stream, "  %-24s %12llu\n", "read", (unsigned long long) total.bytes_read);
+	fprintf(stream, "  %-24s %12llu\n", "written", (unsigned long long) total.bytes_written);
+	fprintf(stream, "Page faults while processing\n");
+	fprintf(stream, "  %-24s %12llu\n", "minor", (unsigned long long) total.minor_faults);
+	fprintf(stream, "  %-24s %12llu\n", "major", (unsigned long long) total.major_faults);
+	fprintf(stream, "Rules\n");
+	for (int i = 0; i < STATS_RULE_COUNT; i++)
+		if (total.rules[i] != 0)
+			fprintf(stream, "  %-24s %12llu\n", rule_names[i],
+				(unsigned long long) total.rules[i]);
+	fprintf(stream, "Latency\n");
+	int last = STATS_LATENCY_BUCKETS - 1;
+	while (last > 0 && total.latency[last] == 0)
+		last--;
+	for (int i = 0; i <= last; i++) {
+		char label[32];
+		if (i < STATS_LATENCY_BUCKETS - 1)
+			snprintf(label, sizeof(label), "< %llu us", 1ULL << (i + 1));
+		else
+			snprintf(label, sizeof(label), ">= %llu us", 1ULL << i);
+		fprintf(stream, "  %-24s %12llu\n", label, (unsigned long long) total.latency[i]);
+	}
+}
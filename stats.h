@@ -0,0 +1,102 @@
+/* termux-elf-cleaner
+
+Copyright (C) 2026 Termux
+
+This file is part of termux-elf-cleaner.
+
+termux-elf-cleaner is free software: you can redistribute it and/or
+modify it under the terms of the GNU General Public License as
+published by the Free Software Foundation, either version 3 of the
+License, or (at your option) any later version.
+
+termux-elf-cleaner is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with termux-elf-cleaner.  If not, see
+<https://www.gnu.org/licenses/>.  */
+
+#ifndef ELF_CLEANER_STATS_H
+#define ELF_CLEANER_STATS_H
+
+#include <stdint.h>
+#include <stdio.h>
+
+#include "elfcleaner.h"
+
+enum stats_phase {
+	PHASE_OPEN,
+	PHASE_STAT,
+	PHASE_IDENT,
+	PHASE_MAP,
+	PHASE_PROCESS,
+	PHASE_WRITE,
+	PHASE_SYNC,
+	PHASE_CLOSE,
+	PHASE_COUNT,
+};
+
+enum stats_outcome {
+	OUTCOME_NOT_ELF,
+	OUTCOME_BIG_ENDIAN,
+	OUTCOME_CLEAN,
+	OUTCOME_MODIFIED,
+	OUTCOME_ERROR,
+	OUTCOME_SKIPPED,
+	OUTCOME_DUPLICATE,
+	OUTCOME_COUNT,
+};
+
+/* Name of outcome as printed in the statistics.  */
+char const* stats_outcome_name(stats_outcome outcome);
+
+/* Changes counted separately: the TLS realignment, each removed section
+   type and dynamic entry, and the DF_1_* rewrite.  */
+#define STATS_RULE_COUNT 16
+
+/* Per-file latency buckets: bucket i counts files that took less than
+   2^(i+1) microseconds, the last one everything slower.  */
+#define STATS_LATENCY_BUCKETS 24
+
+/* Counters of one thread.  Only that thread writes them, so they are
+   plain integers, padded to keep threads off each other's cache lines.  */
+struct alignas(64) run_stats {
+	uint64_t phase_ns[PHASE_COUNT];
+	uint64_t outcomes[OUTCOME_COUNT];
+	uint64_t rules[STATS_RULE_COUNT];
+	uint64_t latency[STATS_LATENCY_BUCKETS];
+	uint64_t bytes_mapped;
+	uint64_t bytes_read;
+	uint64_t bytes_written;
+	/* Files rejected from their first EI_NIDENT bytes alone.  */
+	uint64_t ident_rejects;
+	uint64_t minor_faults;
+	uint64_t major_faults;
+
+	void add_changes(elfcleaner::result const& res);
+	void add_latency(uint64_t ns);
+};
+
+/* Allocate counters for the threads of a pool of the given size; other
+   threads get their own on first use.  Until this is called collection
+   is disabled.  */
+void stats_init(unsigned int workers);
+
+/* The counters of the calling thread, or nullptr when disabled.  */
+run_stats* thread_stats();
+
+/* Monotonic time in nanoseconds.  */
+uint64_t stats_clock();
+
+/* Add the time since start to phase and return the current time, so
+   consecutive phases can be timed from one clock reading each.  Does
+   nothing and returns 0 when stats is nullptr.  */
+uint64_t stats_lap(run_stats* stats, stats_phase phase, uint64_t start);
+
+/* Merge the counters of all threads and print them to stream, as JSON
+   if json is set.  Must only be called while no worker is running.  */
+void stats_print(FILE* stream, bool json);
+
+#endif
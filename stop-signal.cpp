@@ -0,0 +1,62 @@
+/* termux-elf-cleaner
+
+Copyright (C) 2026 Termux
+
+This file is part of termux-elf-cleaner.
+
+termux-elf-cleaner is free software: you can redistribute it and/or
+modify it under the terms of the GNU General Public License as
+published by the Free Software Foundation, either version 3 of the
+License, or (at your option) any later version.
+
+termux-elf-cleaner is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with termux-elf-cleaner.  If not, see
+<https://www.gnu.org/licenses/>.  */
+
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE
+#endif
+
+#include <errno.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <unistd.h>
+
+#include <mutex>
+
+#include "file-log.h"
+#include "stop-signal.h"
+
+/* Written to by the handler.  */
+static int signal_pipe[2] = {-1, -1};
+
+static void on_signal(int)
+{
+	int const saved_errno = errno;
+	char const c = 0;
+	ssize_t const n = write(signal_pipe[1], &c, 1);
+	(void) n;
+	errno = saved_errno;
+}
+
+int stop_signal_fd()
+{
+	static std::once_flag once;
+	std::call_once(once, []() {
+		if (pipe2(signal_pipe, O_CLOEXEC | O_NONBLOCK) != 0) {
+			log_perror("pipe2()");
+			return;
+		}
+		struct sigaction action = {};
+		action.sa_handler = on_signal;
+		sigemptyset(&action.sa_mask);
+		sigaction(SIGINT, &action, NULL);
+		sigaction(SIGTERM, &action, NULL);
+	});
+	return signal_pipe[0];
+}
@@ -0,0 +1,30 @@
+/* termux-elf-cleaner
+
+Copyright (C) 2026 Termux
+
+This file is part of termux-elf-cleaner.
+
+termux-elf-cleaner is free software: you can redistribute it and/or
+modify it under the terms of the GNU General Public License as
+published by the Free Software Foundation, either version 3 of the
+License, or (at your option) any later version.
+
+termux-elf-cleaner is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with termux-elf-cleaner.  If not, see
+<https://www.gnu.org/licenses/>.  */
+
+#ifndef ELF_CLEANER_STOP_SIGNAL_H
+#define ELF_CLEANER_STOP_SIGNAL_H
+
+/* A descriptor that becomes readable once SIGINT or SIGTERM has been
+   received, for event loops that run until they are interrupted.  The
+   handlers are installed on the first call.  Returns -1 after printing
+   an error if the descriptor cannot be set up.  */
+int stop_signal_fd();
+
+#endif
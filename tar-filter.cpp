@@ -0,0 +1,430 @@
+/* termux-elf-cleaner
+
+Copyright (C) 2026 Termux
+
+This file is part of termux-elf-cleaner.
+
+termux-elf-cleaner is free software: you can redistribute it and/or
+modify it under the terms of the GNU General Public License as
+published by the Free Software Foundation, either version 3 of the
+License, or (at your option) any later version.
+
+termux-elf-cleaner is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with termux-elf-cleaner.  If not, see
+<https://www.gnu.org/licenses/>.  */
+
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE
+#endif
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdint.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "elf.h"
+#include "elf-cleaner.h"
+#include "file-log.h"
+#include "io-engine.h"
+#include "stats.h"
+#include "tar-filter.h"
+
+#define TAR_BLOCK_SIZE 512
+
+/* Largest chunk passed to a single splice() or copy_file_range().  */
+#define COPY_CHUNK_SIZE (1 << 20)
+
+/* Buffer for copying with read() and write().  */
+#define COPY_BUFFER_SIZE (64 * 1024)
+
+/* Offsets of the ustar header fields used here.  */
+#define TAR_NAME 0
+#define TAR_NAME_SIZE 100
+#define TAR_SIZE 124
+#define TAR_SIZE_SIZE 12
+#define TAR_CHECKSUM 148
+#define TAR_CHECKSUM_SIZE 8
+#define TAR_TYPEFLAG 156
+#define TAR_MAGIC 257
+#define TAR_PREFIX 345
+#define TAR_PREFIX_SIZE 155
+/* Set in GNU sparse headers, and in each of the sparse extension headers
+   that follow them, when another extension header follows.  */
+#define TAR_GNU_IS_EXTENDED 482
+#define TAR_GNU_EXTENSION_IS_EXTENDED 504
+
+namespace {
+
+class tar_stream {
+public:
+	tar_stream(int in_fd, int out_fd) : in_fd(in_fd), out_fd(out_fd) {}
+
+	/* Read a block into block.  Returns 1 if one was read, 0 at the end
+	   of the stream and -1 after logging an error.  */
+	int read_block(uint8_t* block)
+	{
+		size_t got = 0;
+		while (got < TAR_BLOCK_SIZE) {
+			ssize_t n = ::read(in_fd, block + got, TAR_BLOCK_SIZE - got);
+			if (n < 0) {
+				if (errno == EINTR)
+					continue;
+				log_perror("read()");
+				return -1;
+			}
+			if (n == 0) {
+				if (got == 0)
+					return 0;
+				return truncated();
+			}
+			got += n;
+		}
+		offset += TAR_BLOCK_SIZE;
+		return 1;
+	}
+
+	/* Read length bytes, or log an error and return false.  */
+	bool read(uint8_t* data, size_t length)
+	{
+		while (length > 0) {
+			ssize_t n = ::read(in_fd, data, length);
+			if (n < 0) {
+				if (errno == EINTR)
+					continue;
+				log_perror("read()");
+				return false;
+			}
+			if (n == 0)
+				return truncated() == 0;
+			data += n;
+			length -= n;
+			offset += n;
+		}
+		return true;
+	}
+
+	bool write(uint8_t const* data, size_t length)
+	{
+		while (length > 0) {
+			ssize_t n = ::write(out_fd, data, length);
+			if (n < 0) {
+				if (errno == EINTR)
+					continue;
+				log_perror("write()");
+				return false;
+			}
+			data += n;
+			length -= n;
+		}
+		return true;
+	}
+
+	/* Pass length bytes through, or everything up to the end of the
+	   stream if to_end.  Tries splice(), which needs a pipe on one
+	   side, then copy_file_range(), which needs files on both, and
+	   falls back to read() and write().  */
+	bool copy(size_t length, bool to_end = false)
+	{
+		while (length > 0) {
+			size_t const chunk = std::min(length, size_t(COPY_CHUNK_SIZE));
+			ssize_t n;
+			if (use_splice) {
+				n = splice(in_fd, NULL, out_fd, NULL, chunk, SPLICE_F_MOVE | SPLICE_F_MORE);
+				if (n < 0 && errno == EINVAL) {
+					use_splice = false;
+					continue;
+				}
+			} else if (use_copy_file_range) {
+				n = copy_file_range(in_fd, NULL, out_fd, NULL, chunk, 0);
+				if (n < 0 && (errno == EINVAL || errno == EXDEV || errno == EBADF ||
+					      errno == ENOSYS || errno == EOPNOTSUPP)) {
+					use_copy_file_range = false;
+					continue;
+				}
+			} else {
+				if (!buffer)
+					buffer.reset(new uint8_t[COPY_BUFFER_SIZE]);
+				n = ::read(in_fd, buffer.get(), std::min(chunk, size_t(COPY_BUFFER_SIZE)));
+				if (n > 0 && !write(buffer.get(), n))
+					return false;
+			}
+			if (n < 0) {
+				if (errno == EINTR)
+					continue;
+				log_perror("copy");
+				return false;
+			}
+			if (n == 0)
+				return to_end || truncated() == 0;
+			length -= n;
+			offset += n;
+		}
+		return true;
+	}
+
+	/* Offset in the input stream, for messages.  */
+	unsigned long long position() const { return offset; }
+
+private:
+	int truncated()
+	{
+		log_error("%s: Tar stream ends in the middle of a file", PACKAGE_NAME);
+		return -1;
+	}
+
+	int const in_fd;
+	int const out_fd;
+	unsigned long long offset = 0;
+	bool use_splice = true;
+	bool use_copy_file_range = true;
+	std::unique_ptr<uint8_t[]> buffer;
+};
+
+size_t round_to_blocks(size_t size)
+{
+	return (size + TAR_BLOCK_SIZE - 1) & ~size_t(TAR_BLOCK_SIZE - 1);
+}
+
+/* Parse a numeric header field: octal digits ended by a space or NUL,
+   or a big-endian base-256 number if the first byte has its top bit
+   set.  */
+bool parse_number(uint8_t const* field, size_t length, uint64_t& value)
+{
+	value = 0;
+	if (field[0] & 0x80) {
+		if (field[0] != 0x80)
+			return false;
+		for (size_t i = 1; i < length; i++) {
+			if (value >> 56)
+				return false;
+			value = (value << 8) | field[i];
+		}
+		return true;
+	}
+	size_t i = 0;
+	while (i < length && field[i] == ' ')
+		i++;
+	size_t const start = i;
+	for (; i < length && field[i] >= '0' && field[i] <= '7'; i++)
+		value = (value << 3) | (field[i] - '0');
+	return i > start && (i == length || field[i] == ' ' || field[i] == '\0');
+}
+
+/* Whether the checksum of header is right, summed either as unsigned or,
+   as some old tars did, as signed bytes.  */
+bool checksum_ok(uint8_t const* header)
+{
+	uint64_t stored;
+	if (!parse_number(header + TAR_CHECKSUM, TAR_CHECKSUM_SIZE, stored))
+		return false;
+	uint64_t sum = 0;
+	int64_t signed_sum = 0;
+	for (size_t i = 0; i < TAR_BLOCK_SIZE; i++) {
+		bool const in_checksum = i >= TAR_CHECKSUM && i < TAR_CHECKSUM + TAR_CHECKSUM_SIZE;
+		uint8_t const byte = in_checksum ? ' ' : header[i];
+		sum += byte;
+		signed_sum += (int8_t) byte;
+	}
+	return stored == sum || (int64_t) stored == signed_sum;
+}
+
+std::string header_field(uint8_t const* field, size_t length)
+{
+	auto const* s = reinterpret_cast<char const*>(field);
+	return std::string(s, strnlen(s, length));
+}
+
+/* The path of the file in a ustar or older header.  */
+std::string header_name(uint8_t const* header)
+{
+	std::string name = header_field(header + TAR_NAME, TAR_NAME_SIZE);
+	if (memcmp(header + TAR_MAGIC, "ustar", 5) == 0 && header[TAR_PREFIX] != '\0')
+		name = header_field(header + TAR_PREFIX, TAR_PREFIX_SIZE) + "/" + name;
+	return name;
+}
+
+/* Read the path and size out of the records of a pax extended header,
+   each "<length> <key>=<value>\n".  */
+void parse_pax_records(std::vector<uint8_t> const& data, size_t length,
+		       std::string& path, uint64_t& size, bool& has_size)
+{
+	std::string_view rest(reinterpret_cast<char const*>(data.data()), length);
+	while (!rest.empty()) {
+		size_t record_length = 0;
+		size_t i = 0;
+		for (; i < rest.size() && rest[i] >= '0' && rest[i] <= '9'; i++)
+			record_length = record_length * 10 + (rest[i] - '0');
+		if (i == 0 || i >= rest.size() || rest[i] != ' ' ||
+		    record_length <= i + 1 || record_length > rest.size())
+			return;
+		std::string_view record = rest.substr(i + 1, record_length - i - 2);
+		rest.remove_prefix(record_length);
+		size_t const equals = record.find('=');
+		if (equals == std::string_view::npos)
+			continue;
+		std::string_view const key = record.substr(0, equals);
+		std::string_view const value = record.substr(equals + 1);
+		if (key == "path") {
+			path = value;
+		} else if (key == "size") {
+			size = 0;
+			for (char c : value)
+				size = size * 10 + (c - '0');
+			has_size = true;
+		}
+	}
+}
+
+/* Whether files of this type have their contents in the stream.  */
+bool has_contents(uint8_t typeflag)
+{
+	switch (typeflag) {
+	case '1': // hard link
+	case '2': // symbolic link
+	case '3': // character device
+	case '4': // block device
+	case '6': // FIFO
+		return false;
+	}
+	return true;
+}
+
+bool is_regular_file(uint8_t typeflag)
+{
+	return typeflag == '0' || typeflag == '\0' || typeflag == '7';
+}
+
+/* Pass the regular file of size bytes through, cleaning it first if it
+   is an ELF file.  */
+bool filter_file(tar_stream& stream, std::string const& name, uint64_t size,
+		 elfcleaner::options const& opts, int& ret)
+{
+	size_t const padded = round_to_blocks(size);
+	run_stats* stats = thread_stats();
+	if (size < sizeof(Elf32_Ehdr)) {
+		if (stats != nullptr)
+			stats->outcomes[OUTCOME_NOT_ELF]++;
+		return stream.copy(padded);
+	}
+
+	// The first block is enough to tell an ELF file, and most files in
+	// a package are none.
+	uint8_t first[TAR_BLOCK_SIZE];
+	if (!stream.read(first, sizeof(first)))
+		return false;
+	if (elfcleaner::identify({first, EI_NIDENT}).code == elfcleaner::status::not_elf) {
+		if (stats != nullptr) {
+			stats->ident_rejects++;
+			stats->outcomes[OUTCOME_NOT_ELF]++;
+		}
+		return stream.write(first, sizeof(first)) && stream.copy(padded - sizeof(first));
+	}
+
+	std::vector<uint8_t> data(padded);
+	memcpy(data.data(), first, sizeof(first));
+	if (!stream.read(data.data() + sizeof(first), padded - sizeof(first)))
+		return false;
+	if (stats != nullptr)
+		stats->bytes_read += padded;
+
+	// A file that cannot be cleaned is passed on as it was, like a file
+	// on disk is not written.
+	std::vector<uint8_t> original;
+	original.assign(data.begin(), data.begin() + size);
+	log_begin(log_reserve(), name.c_str());
+	if (clean_buffer({data.data(), (size_t) size}, name.c_str(), opts) != 0) {
+		memcpy(data.data(), original.data(), size);
+		ret = 1;
+	}
+	log_end();
+	return stream.write(data.data(), padded);
+}
+
+}
+
+int filter_tar_stream(int in_fd, int out_fd, elfcleaner::options const& opts)
+{
+	tar_stream stream(in_fd, out_fd);
+	int ret = 0;
+
+	// Set by pax extended and GNU long name headers for the next file.
+	std::string next_name;
+	uint64_t next_size = 0;
+	bool has_next_size = false;
+
+	uint8_t header[TAR_BLOCK_SIZE];
+	while (true) {
+		int const read_ret = stream.read_block(header);
+		if (read_ret <= 0)
+			return read_ret < 0 ? 1 : ret;
+		unsigned long long const header_offset = stream.position() - TAR_BLOCK_SIZE;
+
+		bool const end = std::all_of(header, header + TAR_BLOCK_SIZE,
+					     [](uint8_t byte) { return byte == 0; });
+		if (end) {
+			// The end of archive blocks and any padding after them.
+			if (!stream.write(header, sizeof(header)) || !stream.copy(SIZE_MAX, true))
+				return 1;
+			return ret;
+		}
+
+		uint64_t size;
+		if (!checksum_ok(header) ||
+		    !parse_number(header + TAR_SIZE, TAR_SIZE_SIZE, size)) {
+			log_error("%s: Invalid tar header at offset %llu",
+				  PACKAGE_NAME, header_offset);
+			return 1;
+		}
+		uint8_t const typeflag = header[TAR_TYPEFLAG];
+		if (has_next_size && typeflag != 'x' && typeflag != 'L')
+			size = next_size;
+		if (!has_contents(typeflag))
+			size = 0;
+		if (!stream.write(header, sizeof(header)))
+			return 1;
+
+		bool ok;
+		if (typeflag == 'x' || typeflag == 'L') {
+			std::vector<uint8_t> data(round_to_blocks(size));
+			ok = stream.read(data.data(), data.size()) &&
+				stream.write(data.data(), data.size());
+			if (!ok)
+				return 1;
+			if (typeflag == 'x')
+				parse_pax_records(data, size, next_name, next_size, has_next_size);
+			else
+				next_name = header_field(data.data(), size);
+			continue;
+		} else if (is_regular_file(typeflag)) {
+			std::string const name = next_name.empty() ? header_name(header) : next_name;
+			ok = filter_file(stream, name, size, opts, ret);
+		} else {
+			// GNU sparse files have their extension headers first.
+			bool extended = typeflag == 'S' && header[TAR_GNU_IS_EXTENDED] != 0;
+			ok = true;
+			while (ok && extended) {
+				uint8_t extension[TAR_BLOCK_SIZE];
+				ok = stream.read(extension, sizeof(extension)) &&
+					stream.write(extension, sizeof(extension));
+				extended = extension[TAR_GNU_EXTENSION_IS_EXTENDED] != 0;
+			}
+			ok = ok && stream.copy(round_to_blocks(size));
+		}
+		if (!ok)
+			return 1;
+		next_name.clear();
+		has_next_size = false;
+	}
+}
@@ -0,0 +1,35 @@
+/* termux-elf-cleaner
+
+Copyright (C) 2026 Termux
+
+This file is part of termux-elf-cleaner.
+
+termux-elf-cleaner is free software: you can redistribute it and/or
+modify it under the terms of the GNU General Public License as
+published by the Free Software Foundation, either version 3 of the
+License, or (at your option) any later version.
+
+termux-elf-cleaner is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with termux-elf-cleaner.  If not, see
+<https://www.gnu.org/licenses/>.  */
+
+#ifndef ELF_CLEANER_TAR_FILTER_H
+#define ELF_CLEANER_TAR_FILTER_H
+
+#include "elfcleaner.h"
+
+/* Copy the tar stream on in_fd to out_fd, cleaning the regular files in
+   it that are ELF files on the way.  Only those are held in memory;
+   everything else is passed through, with splice() where one side is a
+   pipe.  Cleaning never changes the size of a file, so the headers are
+   passed on as they are.  Files that cannot be cleaned are passed on
+   unchanged.  Returns 0 on success and 1 if any file could not be
+   cleaned or the stream could not be read or written.  */
+int filter_tar_stream(int in_fd, int out_fd, elfcleaner::options const& opts);
+
+#endif
@@ -0,0 +1,62 @@
+#!/usr/bin/bash
+set -e
+
+if [ $# != 2 ]; then
+  echo "Usage path/to/test-ar-archive.sh <elf-cleaner> <source-dir>"
+  exit 1
+fi
+
+elf_cleaner="$1"
+source_dir="$2"
+test_dir="$(dirname $1)/tests/ar-archive"
+
+rm -rf "$test_dir"
+mkdir -p "$test_dir/members" "$test_dir/extracted"
+cd "$test_dir/members"
+members=()
+for arch in aarch64 arm i686 x86_64; do
+  cp "$source_dir/tests/curl-7.83.1-$arch-original" "curl-$arch.o"
+  # Longer than 15 characters, so the name goes to the long name table.
+  cp "$source_dir/tests/curl-7.83.1-$arch-original" "curl-with-a-long-name-$arch.o"
+  members+=("curl-$arch.o" "curl-with-a-long-name-$arch.o")
+done
+echo "not an ELF file" > notes.txt
+ar rc ../lib.a notes.txt "${members[@]}"
+cp ../lib.a ../original.a
+
+if ! "$elf_cleaner" --api-level 21 --check ../lib.a > ../check-output; then
+  if ! grep -qF "'../lib.a(curl-arm.o)' needs changes" ../check-output; then
+    echo "Unexpected --check output: $(cat ../check-output)"
+    exit 1
+  fi
+else
+  echo "--check found nothing to change in the archive"
+  exit 1
+fi
+
+"$elf_cleaner" --api-level 21 --jobs 4 ../lib.a > ../output
+if ! grep -qF "Removing the DT_RUNPATH dynamic section entry from '../lib.a(curl-with-a-long-name-x86_64.o)'" ../output; then
+  echo "Long member names are not resolved"
+  exit 1
+fi
+
+cd ../extracted
+ar x ../lib.a
+if ! cmp -s ../members/notes.txt notes.txt; then
+  echo "Non-ELF member was changed"
+  exit 1
+fi
+for arch in aarch64 arm i686 x86_64; do
+  for member in "curl-$arch.o" "curl-with-a-long-name-$arch.o"; do
+    if ! cmp -s "$source_dir/tests/curl-7.83.1-$arch-api21-cleaned" "$member"; then
+      echo "Expected and actual files differ for $member"
+      exit 1
+    fi
+  done
+done
+
+# Only member contents may change, never the archive's layout.
+if [ "$(stat -c %s ../lib.a)" != "$(stat -c %s ../original.a)" ]; then
+  echo "Archive size changed"
+  exit 1
+fi
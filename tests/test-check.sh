@@ -0,0 +1,68 @@
+#!/usr/bin/bash
+
+if [ $# != 2 ]; then
+  echo "Usage path/to/test-check.sh <elf-cleaner> <source-dir>"
+  exit 1
+fi
+
+elf_cleaner="$1"
+source_dir="$2"
+test_dir="$(dirname $1)/tests/check"
+
+rm -rf "$test_dir"
+mkdir -p "$test_dir/clean" "$test_dir/mixed"
+for arch in aarch64 arm i686 x86_64; do
+  cp "$source_dir/tests/curl-7.83.1-$arch-api21-cleaned" "$test_dir/clean/curl-$arch"
+  cp "$source_dir/tests/curl-7.83.1-$arch-api21-cleaned" "$test_dir/mixed/curl-$arch"
+done
+cp "$source_dir/tests/curl-7.83.1-arm-original" "$test_dir/mixed/curl-arm"
+
+expect_status() {
+  local expected="$1"
+  shift
+  "$elf_cleaner" --api-level 21 --check "$@" > "$test_dir/output" 2>&1
+  local status=$?
+  if [ $status != $expected ]; then
+    echo "Exit status $status instead of $expected for --check $*"
+    cat "$test_dir/output"
+    exit 1
+  fi
+}
+
+expect_status 0 --recursive "$test_dir/clean"
+expect_status 1 --recursive "$test_dir/mixed"
+if [ "$(cat "$test_dir/output")" != "termux-elf-cleaner: '$test_dir/mixed/curl-arm' needs changes" ]; then
+  echo "Unexpected output: $(cat "$test_dir/output")"
+  exit 1
+fi
+expect_status 2 "$test_dir/clean/curl-arm" "$test_dir/missing"
+# A file needing changes decides the answer over an error.
+expect_status 1 "$test_dir/missing" "$test_dir/mixed/curl-arm"
+
+if ! cmp -s "$source_dir/tests/curl-7.83.1-arm-original" "$test_dir/mixed/curl-arm"; then
+  echo "--check modified a file"
+  exit 1
+fi
+
+# Clean files found by a check are remembered by the skip cache.
+expect_status 0 --cache "$test_dir/index" --recursive "$test_dir/clean"
+expect_status 0 --cache "$test_dir/index" --recursive "$test_dir/clean"
+if [ "$(cat "$test_dir/output")" != "termux-elf-cleaner: Skip cache: 4 hits, 0 misses" ]; then
+  echo "Unexpected cache use: $(cat "$test_dir/output")"
+  exit 1
+fi
+
+# Files given by name are started largest first, so with one job a check
+# stops at the large file needing changes before looking at the small
+# clean one given first; in the given order it looks at both.
+cp "$source_dir/tests/curl-7.83.1-x86_64-original" "$test_dir/large"
+head -c 1048576 /dev/zero >> "$test_dir/large"
+for order in largest given; do
+  expect_status 1 --jobs 1 --order=$order --stats=json "$test_dir/clean/curl-arm" "$test_dir/large"
+  looked_at=1
+  [ $order = given ] && looked_at=2
+  if ! grep -qF "\"files\": $looked_at," "$test_dir/output"; then
+    echo "Not $looked_at files looked at with --order=$order: $(cat "$test_dir/output")"
+    exit 1
+  fi
+done
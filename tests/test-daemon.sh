@@ -0,0 +1,174 @@
+#!/usr/bin/bash
+set -e
+
+if [ $# != 2 ]; then
+  echo "Usage path/to/test-daemon.sh <elf-cleaner> <source-dir>"
+  exit 1
+fi
+
+elf_cleaner="$(realpath "$1")"
+source_dir="$2"
+test_dir="$(dirname $1)/tests/daemon"
+socket="$test_dir/socket"
+
+rm -rf "$test_dir"
+mkdir -p "$test_dir/local" "$test_dir/client"
+cd "$test_dir"
+
+copy_originals() {
+  for arch in aarch64 arm i686 x86_64; do
+    cp "$source_dir/tests/curl-7.83.1-$arch-original" "$1/curl-$arch"
+  done
+}
+
+# Without a daemon the client cleans the files itself.
+copy_originals local
+"$elf_cleaner" --api-level 21 --client "$socket" local/curl-* > fallback.out 2> fallback.err
+if ! grep -q "No daemon is listening" fallback.err; then
+  echo "Falling back to a local run is not reported"
+  exit 1
+fi
+copy_originals local
+"$elf_cleaner" --api-level 21 local/curl-* > local.out
+
+"$elf_cleaner" --daemon "$socket" --jobs 2 &
+daemon_pid=$!
+trap 'kill $daemon_pid 2> /dev/null || true' EXIT
+for i in $(seq 50); do
+  [ -S "$socket" ] && break
+  sleep 0.1
+done
+
+# The client prints what a local run does, under the same names.
+copy_originals client
+cd client
+"$elf_cleaner" --api-level 21 --client "$socket" curl-* > ../client.out
+cd ..
+if ! cmp -s fallback.out local.out || ! diff <(sed 's|local/||' local.out) client.out; then
+  echo "Output of the client differs from a local run"
+  exit 1
+fi
+for arch in aarch64 arm i686 x86_64; do
+  if ! cmp -s "$source_dir/tests/curl-7.83.1-$arch-api21-cleaned" "client/curl-$arch"; then
+    echo "Expected and actual files differ for curl-$arch through the daemon"
+    exit 1
+  fi
+done
+
+# Options are per request.
+cp "$source_dir/tests/curl-7.83.1-arm-original" client/curl-arm
+status=0
+"$elf_cleaner" --api-level 21 --check --client "$socket" client/curl-* > check.out || status=$?
+if [ $status != 1 ] || ! cmp -s "$source_dir/tests/curl-7.83.1-arm-original" client/curl-arm; then
+  echo "Exit status $status for --check through the daemon"
+  exit 1
+fi
+status=0
+"$elf_cleaner" --check --client "$socket" client/curl-aarch64 missing > /dev/null 2>&1 || status=$?
+if [ $status != 2 ]; then
+  echo "Exit status $status for a missing file through the daemon"
+  exit 1
+fi
+"$elf_cleaner" --api-level 21 --log-format json --client "$socket" client/curl-arm > json.out
+if ! grep -q '"file": "client/curl-arm", "outcome": "modified"' json.out; then
+  echo "Unexpected JSON output: $(cat json.out)"
+  exit 1
+fi
+if [ -n "$("$elf_cleaner" --quiet --api-level 21 --client "$socket" client/curl-arm)" ]; then
+  echo "--quiet is not honoured through the daemon"
+  exit 1
+fi
+
+# Descriptors passed with SCM_RIGHTS are cleaned in place, under the
+# name sent with them.
+pass_fd() {
+  python3 - "$socket" "$1" "$2" <<'PYTHON'
+import os, re, socket, sys
+s = socket.socket(socket.AF_UNIX)
+s.connect(sys.argv[1])
+fd = os.open(sys.argv[2], getattr(os, sys.argv[3]))
+s.sendall(b"termux-elf-cleaner 1\noption api-level 21\n")
+socket.send_fds(s, [b"fd passed-arm\n"], [fd])
+try:
+    s.sendall(b"run\n")
+except BrokenPipeError:
+    pass
+answer = b""
+while not re.search(rb"exit \d+\n$", answer):
+    data = s.recv(65536)
+    if not data:
+        sys.exit(1)
+    answer += data
+sys.stdout.buffer.write(answer)
+PYTHON
+}
+cp "$source_dir/tests/curl-7.83.1-arm-original" client/curl-arm
+pass_fd client/curl-arm O_RDWR > fd.out
+if ! grep -q "from 'passed-arm'" fd.out ||
+    ! cmp -s "$source_dir/tests/curl-7.83.1-arm-api21-cleaned" client/curl-arm; then
+  echo "Passed descriptor was not cleaned: $(cat fd.out)"
+  exit 1
+fi
+
+# A descriptor only open for reading does not get the file changed.
+cp "$source_dir/tests/curl-7.83.1-arm-original" client/curl-arm
+pass_fd client/curl-arm O_RDONLY > fd.out
+if ! grep -q "not open for reading and writing" fd.out || ! grep -q "^exit 1$" fd.out ||
+    ! cmp -s "$source_dir/tests/curl-7.83.1-arm-original" client/curl-arm; then
+  echo "Read-only descriptor was not refused: $(cat fd.out)"
+  exit 1
+fi
+
+# Neither are clients of other users.  The client drops to nobody before
+# connecting, reaching the socket through a directory opened beforehand.
+if [ "$(id -u)" = 0 ]; then
+  chmod 777 "$socket"
+  python3 - "$test_dir" > other-user.out <<'PYTHON'
+import os, socket, sys
+directory = os.open(sys.argv[1], os.O_PATH)
+os.setgroups([])
+os.setresgid(65534, 65534, 65534)
+os.setresuid(65534, 65534, 65534)
+s = socket.socket(socket.AF_UNIX)
+s.connect("/proc/self/fd/%d/socket" % directory)
+try:
+    s.sendall(b"termux-elf-cleaner 1\nfile client/curl-arm\nrun\n")
+except BrokenPipeError:
+    pass
+answer = b""
+while data := s.recv(65536):
+    answer += data
+sys.stdout.buffer.write(answer)
+PYTHON
+  if ! grep -q "Clients of other users are not served" other-user.out ||
+      ! grep -q "^exit 1$" other-user.out; then
+    echo "Client of another user was served: $(cat other-user.out)"
+    exit 1
+  fi
+fi
+
+# A client whose file cannot be opened yet, here a FIFO without a writer,
+# does not hold up the output of other clients.
+mkfifo stalled
+"$elf_cleaner" --client "$socket" stalled > /dev/null 2>&1 &
+stalled_pid=$!
+sleep 0.2
+cp "$source_dir/tests/curl-7.83.1-arm-original" client/curl-arm
+other_status=0
+timeout 10 "$elf_cleaner" --api-level 21 --client "$socket" client/curl-arm > other.out ||
+  other_status=$?
+# Opened for reading and writing, a FIFO does not wait for a reader.
+exec 3<> stalled
+exec 3>&-
+wait $stalled_pid || true
+if [ $other_status != 0 ] || ! grep -q "from 'client/curl-arm'" other.out; then
+  echo "A stalled client held up another one"
+  exit 1
+fi
+
+kill $daemon_pid
+wait $daemon_pid
+if [ -e "$socket" ]; then
+  echo "Socket left behind after the daemon stopped"
+  exit 1
+fi
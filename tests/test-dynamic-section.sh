@@ -1,8 +1,8 @@
 #!/usr/bin/bash
 set -e
 
-if [ $# != 5 ]; then
-  echo "Usage path/to/test-dynamic-section.sh <elf-cleaner> <source-dir> <binary-name> <arch> <api>"
+if [ $# != 5 ] && [ $# != 6 ]; then
+  echo "Usage path/to/test-dynamic-section.sh <elf-cleaner> <source-dir> <binary-name> <arch> <api> [io-engine]"
   exit 1
 fi
 
@@ -12,6 +12,11 @@ binary_name="$3"
 arch="$4"
 api="$5"
 test_dir="$(dirname $1)/tests"
+engine_args=()
+if [ $# = 6 ]; then
+  test_dir="$test_dir/$6"
+  engine_args=(--io-engine "$6")
+fi
 
 progname="$(basename "$elf_cleaner")"
 basefile="$source_dir/tests/$binary_name-$arch"
@@ -37,11 +42,11 @@ fi
 
 mkdir -p "$test_dir"
 cp "$origfile" "$test_dir/"
-if [ "$("$elf_cleaner" --api-level "$api" "$test_dir/$testfile")" != "$expected_logs" ]; then
+if [ "$("$elf_cleaner" "${engine_args[@]}" --api-level "$api" "$test_dir/$testfile")" != "$expected_logs" ]; then
   echo "Logs do not match for $testfile"
   exit 1
 fi
-if not cmp -s "$test_dir/$testfile" "$expectedfile"; then
+if ! cmp -s "$test_dir/$testfile" "$expectedfile"; then
   echo "Expected and actual files differ for $testfile"
   exit 1
 fi
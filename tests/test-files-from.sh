@@ -0,0 +1,53 @@
+#!/usr/bin/bash
+set -e
+
+if [ $# != 2 ]; then
+  echo "Usage path/to/test-files-from.sh <elf-cleaner> <source-dir>"
+  exit 1
+fi
+
+elf_cleaner="$1"
+source_dir="$2"
+test_dir="$(dirname $1)/tests/files-from"
+
+rm -rf "$test_dir"
+mkdir -p "$test_dir/nul" "$test_dir/newline"
+for i in {1..25}; do
+  for arch in aarch64 arm i686 x86_64; do
+    cp "$source_dir/tests/curl-7.83.1-$arch-original" "$test_dir/nul/curl $arch $i"
+    cp "$source_dir/tests/curl-7.83.1-$arch-original" "$test_dir/newline/curl-$arch-$i"
+  done
+done
+
+find "$test_dir/nul" -type f -print0 | "$elf_cleaner" --api-level 21 --quiet --jobs 4 --files-from - -0
+find "$test_dir/newline" -type f > "$test_dir/list"
+"$elf_cleaner" --api-level 21 --quiet --jobs 4 --files-from "$test_dir/list"
+
+for i in {1..25}; do
+  for arch in aarch64 arm i686 x86_64; do
+    for file in "nul/curl $arch $i" "newline/curl-$arch-$i"; do
+      if ! cmp -s "$source_dir/tests/curl-7.83.1-$arch-api21-cleaned" "$test_dir/$file"; then
+        echo "Expected and actual files differ for $file"
+        exit 1
+      fi
+    done
+  done
+done
+
+# Listed names are cleaned as they are read, before the list ends.
+mkdir "$test_dir/stream"
+cp "$source_dir/tests/curl-7.83.1-arm-original" "$test_dir/stream/curl-arm"
+{
+  echo "$test_dir/stream/curl-arm"
+  for i in $(seq 100); do
+    if cmp -s "$source_dir/tests/curl-7.83.1-arm-api21-cleaned" "$test_dir/stream/curl-arm"; then
+      touch "$test_dir/stream/cleaned-early"
+      break
+    fi
+    sleep 0.1
+  done
+} | "$elf_cleaner" --api-level 21 --quiet --files-from -
+if [ ! -e "$test_dir/stream/cleaned-early" ]; then
+  echo "Listed file was not cleaned before the list ended"
+  exit 1
+fi
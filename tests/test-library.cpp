@@ -0,0 +1,91 @@
+/* termux-elf-cleaner
+
+Copyright (C) 2026 Termux
+
+This file is part of termux-elf-cleaner.
+
+termux-elf-cleaner is free software: you can redistribute it and/or
+modify it under the terms of the GNU General Public License as
+published by the Free Software Foundation, either version 3 of the
+License, or (at your option) any later version.
+
+termux-elf-cleaner is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with termux-elf-cleaner.  If not, see
+<https://www.gnu.org/licenses/>.  */
+
+/* Cleans a test binary in memory through libelfcleaner and compares
+   the result with the expected cleaned file.  */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <string>
+#include <vector>
+
+#include "elfcleaner.h"
+
+static std::vector<uint8_t> read_file(std::string const& path)
+{
+	std::vector<uint8_t> bytes;
+	FILE* f = fopen(path.c_str(), "rb");
+	if (f == NULL) {
+		perror(path.c_str());
+		exit(1);
+	}
+	uint8_t buffer[64 * 1024];
+	size_t n;
+	while ((n = fread(buffer, 1, sizeof(buffer), f)) > 0)
+		bytes.insert(bytes.end(), buffer, buffer + n);
+	fclose(f);
+	return bytes;
+}
+
+int main(int argc, char **argv)
+{
+	if (argc != 4) {
+		fprintf(stderr, "Usage: %s <source-dir> <arch> <api>\n", argv[0]);
+		return 1;
+	}
+	std::string const base = std::string(argv[1]) + "/tests/curl-7.83.1-" + argv[2];
+	int const api = atoi(argv[3]);
+
+	std::vector<uint8_t> const original = read_file(base + "-original");
+	std::vector<uint8_t> const expected = read_file(base + "-api" + argv[3] + "-cleaned");
+
+	std::vector<uint8_t> bytes = original;
+	elfcleaner::result res = elfcleaner::clean(bytes, elfcleaner::make_options(api, true));
+	if (res.code != elfcleaner::status::ok || res.changes.empty() || bytes != original) {
+		fprintf(stderr, "Dry run did not report changes or modified the buffer\n");
+		return 1;
+	}
+	size_t const dry_run_changes = res.changes.size();
+
+	res = elfcleaner::clean(bytes, elfcleaner::make_options(api));
+	if (res.code != elfcleaner::status::ok || res.changes.size() != dry_run_changes) {
+		fprintf(stderr, "Unexpected result cleaning the buffer\n");
+		return 1;
+	}
+	if (bytes != expected) {
+		fprintf(stderr, "Expected and actual buffers differ\n");
+		return 1;
+	}
+
+	res = elfcleaner::clean(bytes, elfcleaner::make_options(api));
+	if (res.code != elfcleaner::status::ok || !res.changes.empty()) {
+		fprintf(stderr, "Cleaned buffer was changed again\n");
+		return 1;
+	}
+
+	uint8_t text[] = "#!/bin/sh\nexit 0\n";
+	if (elfcleaner::clean(text, elfcleaner::make_options(api)).code != elfcleaner::status::not_elf) {
+		fprintf(stderr, "Text was not rejected as not ELF\n");
+		return 1;
+	}
+	return 0;
+}
@@ -0,0 +1,115 @@
+#!/usr/bin/bash
+set -e
+
+if [ $# != 2 ]; then
+  echo "Usage path/to/test-log-order.sh <elf-cleaner> <source-dir>"
+  exit 1
+fi
+
+elf_cleaner="$1"
+source_dir="$2"
+test_dir="$(dirname $1)/tests/log-order"
+
+rm -rf "$test_dir"
+mkdir -p "$test_dir/files"
+for i in {1..25}; do
+  for arch in aarch64 arm i686 x86_64; do
+    cp "$source_dir/tests/curl-7.83.1-$arch-original" "$test_dir/files/curl-$arch-$i"
+  done
+  echo "not an ELF file" > "$test_dir/files/text-$i"
+  echo "$test_dir/files/curl-aarch64-$i"
+  echo "$test_dir/files/missing-$i"
+  echo "$test_dir/files/text-$i"
+  echo "$test_dir/files/curl-arm-$i"
+  echo "$test_dir/files/curl-i686-$i"
+  echo "$test_dir/files/curl-x86_64-$i"
+done > "$test_dir/list"
+
+run() {
+  "$elf_cleaner" --api-level 21 --dry-run "$@" --files-from "$test_dir/list" 2>&1
+}
+
+# Messages must come out in list order whatever the number of jobs.
+run --jobs 1 > "$test_dir/expected"
+for jobs in 2 4 8; do
+  run --jobs $jobs > "$test_dir/actual"
+  if ! cmp -s "$test_dir/expected" "$test_dir/actual"; then
+    echo "Output with $jobs jobs differs from the output with one job"
+    exit 1
+  fi
+done
+
+# Also when files are handed to the workers in batches.
+run --jobs 4 --io-engine uring > "$test_dir/actual"
+if ! cmp -s "$test_dir/expected" "$test_dir/actual"; then
+  echo "Output with the uring engine differs from the output with mmap"
+  exit 1
+fi
+
+run --jobs 4 --log-format json > "$test_dir/json"
+if [ "$(sed -e 's/^{"file": "\([^"]*\)".*/\1/' "$test_dir/json")" != "$(cat "$test_dir/list")" ]; then
+  echo "JSON lines are not in list order"
+  exit 1
+fi
+if [ "$(grep -c '"outcome": "modified"' "$test_dir/json")" != 100 ] ||
+   [ "$(grep -c '"outcome": "error", .*No such file' "$test_dir/json")" != 25 ] ||
+   [ "$(grep -c '"outcome": "not_elf"' "$test_dir/json")" != 25 ]; then
+  echo "Unexpected JSON outcomes"
+  exit 1
+fi
+
+# Messages about files with long names are neither cut short nor left
+# without their line ends.
+long_dir="$test_dir/$(printf 'd%.0s' {1..200})/$(printf 'e%.0s' {1..200})/$(printf 'f%.0s' {1..200})"
+mkdir -p "$long_dir"
+cp "$source_dir/tests/curl-7.83.1-arm-original" "$long_dir/curl"
+"$elf_cleaner" --api-level 21 --dry-run "$long_dir/curl" "$long_dir/missing" \
+  > "$test_dir/long" 2>&1
+if [ "$(grep -c "^termux-elf-cleaner: .*'$long_dir/curl'" "$test_dir/long")" != 8 ] ||
+   ! grep -qxF "open(\"$long_dir/missing\"): No such file or directory" "$test_dir/long" ||
+   [ "$(wc -l < "$test_dir/long")" != 9 ]; then
+  echo "Messages about a long name were cut:"
+  cat "$test_dir/long"
+  exit 1
+fi
+"$elf_cleaner" --api-level 21 --dry-run --log-format json "$long_dir/curl" > "$test_dir/long-json"
+if [ "$(wc -l < "$test_dir/long-json")" != 1 ] || ! grep -q '"outcome": "modified", .*"errors": \[\]}$' "$test_dir/long-json"; then
+  echo "JSON line about a long name was cut:"
+  cat "$test_dir/long-json"
+  exit 1
+fi
+
+# Files finished behind one that is slow are only held for a window of
+# positions: the run stops taking names until it is done, then goes on.
+mkfifo "$test_dir/stalled"
+{
+  echo "$test_dir/stalled"
+  for i in {1..20000}; do
+    echo "$test_dir/files/text-1"
+  done
+} > "$test_dir/stalled-list"
+while read -r name; do
+  echo "$name"
+  echo x >> "$test_dir/stalled-taken"
+done < "$test_dir/stalled-list" |
+  "$elf_cleaner" --api-level 21 --jobs 2 --log-format json \
+    --files-from - > "$test_dir/stalled-json" &
+stalled_pid=$!
+sleep 2
+taken=$(wc -l < "$test_dir/stalled-taken")
+exec 3<> "$test_dir/stalled"
+exec 3>&-
+if ! timeout 60 tail --pid=$stalled_pid -f /dev/null; then
+  kill $stalled_pid
+  echo "Run behind a slow file did not finish"
+  exit 1
+fi
+wait $stalled_pid
+if [ "$taken" -ge 15000 ]; then
+  echo "$taken names were taken behind a slow file"
+  exit 1
+fi
+if [ "$(sed -e 's/^{"file": "\([^"]*\)".*/\1/' "$test_dir/stalled-json")" != "$(cat "$test_dir/stalled-list")" ]; then
+  echo "JSON lines behind a slow file are not in list order"
+  exit 1
+fi
@@ -0,0 +1,86 @@
+#!/usr/bin/bash
+set -e
+
+if [ $# != 2 ]; then
+  echo "Usage path/to/test-output-copy.sh <elf-cleaner> <source-dir>"
+  exit 1
+fi
+
+elf_cleaner="$1"
+source_dir="$2"
+test_dir="$(dirname $1)/tests/output-copy"
+
+rm -rf "$test_dir"
+mkdir -p "$test_dir/in/bin"
+for arch in aarch64 arm i686 x86_64; do
+  cp "$source_dir/tests/curl-7.83.1-$arch-original" "$test_dir/in/bin/curl-$arch"
+done
+cp "$source_dir/tests/curl-7.83.1-arm-api21-cleaned" "$test_dir/in/bin/clean-arm"
+chmod 750 "$test_dir/in/bin/curl-arm"
+echo "not an ELF file" > "$test_dir/in/text"
+chmod -R a-w "$test_dir/in"
+cd "$test_dir"
+
+check_copies() {
+  local out="$1" suffix="$2"
+  for arch in aarch64 arm i686 x86_64; do
+    if ! cmp -s "$source_dir/tests/curl-7.83.1-$arch-api21-cleaned" "$out/bin/curl-$arch$suffix"; then
+      echo "Copy of curl-$arch in $out differs from the expected file"
+      exit 1
+    fi
+    if ! cmp -s "$source_dir/tests/curl-7.83.1-$arch-original" "in/bin/curl-$arch"; then
+      echo "Original of curl-$arch was changed"
+      exit 1
+    fi
+  done
+  if [ "$(stat -c %a "$out/bin/curl-arm$suffix")" != "$(stat -c %a in/bin/curl-arm)" ]; then
+    echo "Mode of the copy in $out was not kept"
+    exit 1
+  fi
+  # Only files that needed changes are written.
+  if [ -e "$out/bin/clean-arm$suffix" ] || [ -e "$out/text$suffix" ]; then
+    echo "Files needing no changes were copied to $out"
+    exit 1
+  fi
+}
+
+for engine in mmap uring; do
+  rm -rf out
+  "$elf_cleaner" --api-level 21 --io-engine $engine --output-dir out --recursive in > /dev/null
+  check_copies out/in ""
+  # Copies already there are replaced.
+  "$elf_cleaner" --api-level 21 --io-engine $engine --output-dir out "$PWD/in/bin/curl-arm" > /dev/null
+  if ! cmp -s "$source_dir/tests/curl-7.83.1-arm-api21-cleaned" "out/$PWD/in/bin/curl-arm"; then
+    echo "Absolute name was not placed below the output directory"
+    exit 1
+  fi
+  "$elf_cleaner" --api-level 21 --io-engine $engine --output-dir out --recursive in > /dev/null
+  check_copies out/in ""
+  if [ -n "$(find out -name '*.tmp.*' -o -name '*.XXXXXX')" ]; then
+    echo "Temporary files were left behind"
+    exit 1
+  fi
+done
+
+chmod u+w in/bin
+"$elf_cleaner" --api-level 21 --suffix .cleaned in/bin/* > /dev/null
+check_copies in .cleaned
+
+# Every name of a hard-linked file gets its own copy.
+mkdir linked
+cp "$source_dir/tests/curl-7.83.1-arm-original" linked/a
+ln linked/a linked/b
+rm -rf out
+"$elf_cleaner" --api-level 21 --output-dir out linked/a linked/b > /dev/null
+for file in a b; do
+  if ! cmp -s "$source_dir/tests/curl-7.83.1-arm-api21-cleaned" "out/linked/$file"; then
+    echo "Hard link $file was not copied"
+    exit 1
+  fi
+done
+
+"$elf_cleaner" --output-dir out ../output-copy/in/bin/curl-arm > output 2>&1
+if ! grep -q "cannot be placed below 'out'" output; then
+  echo "Name leaving the output directory was accepted"
+  exit 1
+fi
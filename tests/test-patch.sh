@@ -0,0 +1,97 @@
+#!/usr/bin/bash
+set -e
+
+if [ $# != 2 ]; then
+  echo "Usage path/to/test-patch.sh <elf-cleaner> <source-dir>"
+  exit 1
+fi
+
+elf_cleaner="$1"
+source_dir="$2"
+test_dir="$(dirname $1)/tests/patch"
+
+rm -rf "$test_dir"
+mkdir -p "$test_dir/zip/lib/armeabi-v7a"
+cd "$test_dir"
+
+fill() {
+  mkdir -p "$1"
+  for arch in aarch64 arm i686 x86_64; do
+    cp "$source_dir/tests/curl-7.83.1-$arch-original" "$1/curl-$arch"
+  done
+  cp "$source_dir/tests/curl-7.83.1-arm-api21-cleaned" "$1/clean-arm"
+  echo "not an ELF file" > "$1/text"
+  cp zip.apk "$1/curl.apk"
+}
+
+cp "$source_dir/tests/curl-7.83.1-arm-original" zip/lib/armeabi-v7a/libcurl.so
+(cd zip && zip -q -0 ../zip.apk lib/armeabi-v7a/libcurl.so)
+fill build
+fill deploy
+fill expected
+(cd expected && "$elf_cleaner" --api-level 21 * > ../expected.out)
+
+# Emitting leaves the files alone and prints what a run would.
+(cd build && "$elf_cleaner" --api-level 21 --jobs 4 --emit-patch ../first.patch * > ../emit.out)
+(cd build && "$elf_cleaner" --api-level 21 --jobs 2 --emit-patch ../second.patch * > /dev/null)
+if ! cmp -s emit.out expected.out; then
+  echo "Emitting printed other messages than cleaning"
+  exit 1
+fi
+if ! cmp -s first.patch second.patch; then
+  echo "Manifests of the same files differ"
+  exit 1
+fi
+if ! cmp -s "$source_dir/tests/curl-7.83.1-arm-original" build/curl-arm; then
+  echo "Emitting changed a file"
+  exit 1
+fi
+
+status=0
+(cd deploy && "$elf_cleaner" --check --apply-patch ../first.patch > /dev/null) || status=$?
+if [ $status != 1 ]; then
+  echo "Exit status $status for --check --apply-patch"
+  exit 1
+fi
+(cd deploy && "$elf_cleaner" --apply-patch ../first.patch > ../apply.out)
+for file in curl-aarch64 curl-arm curl-i686 curl-x86_64 clean-arm text curl.apk; do
+  if ! cmp -s "expected/$file" "deploy/$file"; then
+    echo "Patched $file differs from the cleaned one"
+    exit 1
+  fi
+done
+if [ "$(wc -l < apply.out)" != 5 ]; then
+  echo "Unexpected output of --apply-patch: $(cat apply.out)"
+  exit 1
+fi
+
+# Applying again finds everything done; other files are refused.
+(cd deploy && "$elf_cleaner" --check --apply-patch ../first.patch > /dev/null)
+cp "$source_dir/tests/curl-7.83.1-i686-original" deploy/curl-arm
+(cd deploy && "$elf_cleaner" --apply-patch ../first.patch > ../mismatch.out 2>&1)
+if ! grep -qF "'curl-arm' is not the file the patch was made for" mismatch.out ||
+    ! cmp -s "$source_dir/tests/curl-7.83.1-i686-original" deploy/curl-arm; then
+  echo "Patch was applied to another file"
+  exit 1
+fi
+
+head -c 100 first.patch > truncated.patch
+if "$elf_cleaner" --apply-patch truncated.patch 2> /dev/null; then
+  echo "Truncated manifest was accepted"
+  exit 1
+fi
+
+# Every name of a hard-linked file gets an entry.
+mkdir linked linked-deploy
+cp "$source_dir/tests/curl-7.83.1-arm-original" linked/a
+ln linked/a linked/b
+(cd linked && "$elf_cleaner" --api-level 21 --emit-patch ../linked.patch a b > /dev/null)
+cp linked/a linked-deploy/a
+cp linked/a linked-deploy/b
+(cd linked-deploy && "$elf_cleaner" --apply-patch ../linked.patch > /dev/null)
+for file in a b; do
+  if ! cmp -s "$source_dir/tests/curl-7.83.1-arm-api21-cleaned" "linked-deploy/$file"; then
+    echo "Hard link $file got no manifest entry"
+    exit 1
+  fi
+done
@@ -0,0 +1,39 @@
+#!/usr/bin/bash
+set -e
+
+if [ $# != 2 ]; then
+  echo "Usage path/to/test-recursive.sh <elf-cleaner> <source-dir>"
+  exit 1
+fi
+
+elf_cleaner="$1"
+source_dir="$2"
+test_dir="$(dirname $1)/tests/recursive"
+
+rm -rf "$test_dir"
+for arch in aarch64 arm i686 x86_64; do
+  for depth in a a/b a/b/c; do
+    mkdir -p "$test_dir/$arch/$depth" "$test_dir/$arch/$depth/skipped"
+    cp "$source_dir/tests/curl-7.83.1-$arch-original" "$test_dir/$arch/$depth/libcurl.so"
+    cp "$source_dir/tests/curl-7.83.1-$arch-original" "$test_dir/$arch/$depth/curl.keep"
+    cp "$source_dir/tests/curl-7.83.1-$arch-original" "$test_dir/$arch/$depth/skipped/libcurl.so"
+  done
+done
+
+"$elf_cleaner" --api-level 21 --quiet --jobs 4 --recursive \
+  --include '*.so' --exclude skipped "$test_dir"
+
+for arch in aarch64 arm i686 x86_64; do
+  for depth in a a/b a/b/c; do
+    if ! cmp -s "$source_dir/tests/curl-7.83.1-$arch-api21-cleaned" "$test_dir/$arch/$depth/libcurl.so"; then
+      echo "Expected and actual files differ for $arch/$depth/libcurl.so"
+      exit 1
+    fi
+    for untouched in curl.keep skipped/libcurl.so; do
+      if ! cmp -s "$source_dir/tests/curl-7.83.1-$arch-original" "$test_dir/$arch/$depth/$untouched"; then
+        echo "Filtered file $arch/$depth/$untouched was modified"
+        exit 1
+      fi
+    done
+  done
+done
@@ -0,0 +1,95 @@
+#!/usr/bin/bash
+set -e
+
+if [ $# != 2 ]; then
+  echo "Usage path/to/test-skip-cache.sh <elf-cleaner> <source-dir>"
+  exit 1
+fi
+
+elf_cleaner="$1"
+source_dir="$2"
+test_dir="$(dirname $1)/tests/skip-cache"
+progname="$(basename "$elf_cleaner")"
+
+rm -rf "$test_dir"
+mkdir -p "$test_dir"
+for arch in aarch64 arm i686 x86_64; do
+  cp "$source_dir/tests/curl-7.83.1-$arch-original" "$test_dir/curl-$arch"
+done
+
+run() {
+  "$elf_cleaner" --api-level 21 --cache "$test_dir/index" "$test_dir"/curl-* 2>&1 >/dev/null
+}
+
+if [ "$(run)" != "$progname: Skip cache: 0 hits, 4 misses" ]; then
+  echo "First run was not all misses"
+  exit 1
+fi
+if [ "$(run)" != "$progname: Skip cache: 4 hits, 0 misses" ]; then
+  echo "Second run was not all hits"
+  exit 1
+fi
+
+# Replacing a file must invalidate its entry.
+cp "$source_dir/tests/curl-7.83.1-arm-original" "$test_dir/curl-arm"
+if [ "$(run)" != "$progname: Skip cache: 3 hits, 1 misses" ]; then
+  echo "Changed file was not a miss"
+  exit 1
+fi
+
+for arch in aarch64 arm i686 x86_64; do
+  if ! cmp -s "$source_dir/tests/curl-7.83.1-$arch-api21-cleaned" "$test_dir/curl-$arch"; then
+    echo "Expected and actual files differ for curl-$arch"
+    exit 1
+  fi
+done
+
+# A different api level must not reuse the entries.
+if [ "$("$elf_cleaner" --api-level 24 --cache "$test_dir/index" "$test_dir"/curl-* 2>&1 >/dev/null)" != "$progname: Skip cache: 0 hits, 4 misses" ]; then
+  echo "Entries were reused for another api level"
+  exit 1
+fi
+
+# With io_uring batches, files known to be clean are stat()ed by name and
+# never opened or read, which shows in their access time where the file
+# system keeps it.
+"$elf_cleaner" --api-level 21 --cache "$test_dir/index" "$test_dir"/curl-* >/dev/null 2>&1
+touch -a -d 2000-01-01 "$test_dir"/curl-*
+cat "$test_dir/curl-aarch64" > /dev/null
+if [ "$(stat -c %X "$test_dir/curl-aarch64")" != "$(stat -c %X "$test_dir/curl-arm")" ]; then
+  touch -a -d 2000-01-01 "$test_dir/curl-aarch64"
+  if [ "$("$elf_cleaner" --api-level 21 --io-engine uring --cache "$test_dir/index" \
+      "$test_dir"/curl-* 2>&1 >/dev/null)" != "$progname: Skip cache: 4 hits, 0 misses" ]; then
+    echo "Batched run was not all hits"
+    exit 1
+  fi
+  for arch in aarch64 arm i686 x86_64; do
+    if [ "$(stat -c %X "$test_dir/curl-$arch")" != "$(date -d 2000-01-01 +%s)" ]; then
+      echo "Known clean curl-$arch was read"
+      exit 1
+    fi
+  done
+fi
+
+# A run waiting for the lock on an index that another run replaced in the
+# meantime uses the newer index, so its entries are not lost.
+if command -v flock > /dev/null; then
+  cp "$source_dir/tests/curl-7.83.1-arm-original" "$test_dir/waiting"
+  exec 9< "$test_dir/index"
+  flock 9
+  "$elf_cleaner" --api-level 21 --cache "$test_dir/index" "$test_dir/waiting" > /dev/null 2>&1 9<&- &
+  waiting_pid=$!
+  sleep 0.5
+  cp "$test_dir/index" "$test_dir/index.new"
+  mv "$test_dir/index.new" "$test_dir/index"
+  exec 9<&-
+  wait $waiting_pid
+  if [ "$("$elf_cleaner" --api-level 21 --cache "$test_dir/index" "$test_dir/waiting" 2>&1 >/dev/null)" != "$progname: Skip cache: 1 hits, 0 misses" ]; then
+    echo "Entry was written to a replaced index"
+    exit 1
+  fi
+fi
+if [ -n "$(find "$test_dir" -name 'index.*')" ]; then
+  echo "Temporary index files were left behind"
+  exit 1
+fi
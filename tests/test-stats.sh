@@ -0,0 +1,94 @@
+#!/usr/bin/bash
+set -e
+
+if [ $# != 2 ]; then
+  echo "Usage path/to/test-stats.sh <elf-cleaner> <source-dir>"
+  exit 1
+fi
+
+elf_cleaner="$1"
+source_dir="$2"
+test_dir="$(dirname $1)/tests/stats"
+
+rm -rf "$test_dir"
+mkdir -p "$test_dir"
+for arch in aarch64 arm i686 x86_64; do
+  cp "$source_dir/tests/curl-7.83.1-$arch-original" "$test_dir/curl-$arch"
+done
+printf '#!/bin/sh\n# Not an ELF file, but larger than an ELF header.\nexit 0\n' > "$test_dir/text"
+# A big-endian ELF header, rejected from its first bytes like the text.
+printf '\177ELF\002\002\001' > "$test_dir/big-endian"
+head -c 1024 /dev/zero >> "$test_dir/big-endian"
+
+run() {
+  "$elf_cleaner" --api-level 21 --quiet --jobs 2 "$@" "$test_dir"/* 2>&1 >/dev/null
+}
+
+stats="$(run --stats=json)"
+for expected in '"files": 6' '"ident_rejected": 2' '"not_elf": 1' '"big_endian": 1' \
+                '"modified": 4' '"clean": 0' '"error": 0' '"DT_RUNPATH": 4' \
+                '"VERSYM": 4' '"DF_1_FLAGS": 4'; do
+  if ! grep -qF "$expected" <<< "$stats"; then
+    echo "Missing $expected in: $stats"
+    exit 1
+  fi
+done
+
+stats="$(run --stats --io-engine pread)"
+if ! grep -qE '^  clean +4$' <<< "$stats" || ! grep -qE '^  not_elf +1$' <<< "$stats"; then
+  echo "Unexpected outcomes of the second run:"
+  echo "$stats"
+  exit 1
+fi
+
+# A file reached through a hard link, a symbolic link and twice by the
+# same name is cleaned once; the other names count as duplicates.
+mkdir -p "$test_dir/links"
+cp "$source_dir/tests/curl-7.83.1-arm-original" "$test_dir/links/curl"
+ln "$test_dir/links/curl" "$test_dir/links/curl-hard"
+ln -s curl "$test_dir/links/curl-symbolic"
+for engine in mmap uring; do
+  # Rewritten in place, so the links stay.
+  cat "$source_dir/tests/curl-7.83.1-arm-original" > "$test_dir/links/curl"
+  stats="$("$elf_cleaner" --api-level 21 --jobs 4 --io-engine $engine --stats=json \
+    "$test_dir/links/curl" "$test_dir/links/curl-hard" "$test_dir/links/curl-symbolic" \
+    "$test_dir/links/curl" 2>&1 >"$test_dir/links/output")"
+  if ! grep -qF '"modified": 1' <<< "$stats" || ! grep -qF '"duplicate": 3' <<< "$stats"; then
+    echo "Duplicates were not skipped with $engine: $stats"
+    exit 1
+  fi
+  if [ "$(grep -c DT_RUNPATH "$test_dir/links/output")" != 1 ] ||
+      ! cmp -s "$source_dir/tests/curl-7.83.1-arm-api21-cleaned" "$test_dir/links/curl"; then
+    echo "File with several names was not cleaned once with $engine"
+    exit 1
+  fi
+done
+
+# Every sync policy leaves the same cleaned file, with each engine.
+for policy in none file batch; do
+  for engine in mmap pread uring; do
+    cp "$source_dir/tests/curl-7.83.1-x86_64-original" "$test_dir/links/curl"
+    stats="$("$elf_cleaner" --api-level 21 --quiet --sync=$policy --io-engine $engine \
+      --stats=json "$test_dir/links/curl" 2>&1)"
+    if ! grep -qF '"modified": 1' <<< "$stats" ||
+        ! cmp -s "$source_dir/tests/curl-7.83.1-x86_64-api21-cleaned" "$test_dir/links/curl"; then
+      echo "File not cleaned with --sync=$policy and $engine: $stats"
+      exit 1
+    fi
+  done
+done
+
+# Reading only what is looked at leaves the same cleaned files, archives
+# included, with each engine.
+for engine in mmap pread uring; do
+  cp "$source_dir/tests/curl-7.83.1-aarch64-original" "$test_dir/links/curl"
+  rm -f "$test_dir/links/curl.a"
+  ar rc "$test_dir/links/curl.a" "$test_dir/links/curl"
+  stats="$("$elf_cleaner" --api-level 21 --quiet --page-cache=sparse --io-engine $engine \
+    --stats=json "$test_dir/links/curl" "$test_dir/links/curl.a" 2>&1)"
+  if ! grep -qF '"modified": 2' <<< "$stats" ||
+      ! cmp -s "$source_dir/tests/curl-7.83.1-aarch64-api21-cleaned" "$test_dir/links/curl"; then
+    echo "Files not cleaned with --page-cache=sparse and $engine: $stats"
+    exit 1
+  fi
+done
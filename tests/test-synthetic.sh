@@ -0,0 +1,66 @@
+#!/usr/bin/bash
+set -e
+
+if [ $# != 2 ]; then
+  echo "Usage path/to/test-synthetic.sh <elf-cleaner> <elf-cleaner-gen-corpus>"
+  exit 1
+fi
+
+elf_cleaner="$1"
+gen_corpus="$2"
+test_dir="$(dirname $1)/tests/synthetic"
+
+rm -rf "$test_dir"
+mkdir -p "$test_dir"
+
+# Half of the files need changes.  70000 sections need extended numbering
+# and an empty dynamic section must be left alone.
+"$gen_corpus" --output-dir "$test_dir/small" --count 4 --clean-ratio 0.5 --tls
+"$gen_corpus" --output-dir "$test_dir/large" --count 2 --clean-ratio 0.5 \
+  --sections 70000 --dynamic-entries 2000
+"$gen_corpus" --output-dir "$test_dir/empty" --count 1 --dynamic-entries 0
+
+output="$("$elf_cleaner" --api-level 21 "$test_dir"/*/* 2>&1)"
+
+for file in "$test_dir"/small/* "$test_dir"/large/*; do
+  n="${file##*-}"
+  if [ $((10#$n % 2)) = 1 ]; then
+    if grep -qF "'$file'" <<< "$output"; then
+      echo "Clean file $file was changed"
+      exit 1
+    fi
+  else
+    for message in "Removing VERSYM section from '$file'" \
+                   "Removing the DT_RUNPATH dynamic section entry from '$file'" \
+                   "Replacing unsupported DF_1_* flags 134217729 with 1 in '$file'"; do
+      if ! grep -qF "$message" <<< "$output"; then
+        echo "Missing: $message"
+        exit 1
+      fi
+    done
+  fi
+done
+
+for file in "$test_dir"/small/*; do
+  n="${file##*-}"
+  if [ $((10#$n % 2)) = 0 ] && ! grep -qF "Changing TLS alignment for '$file'" <<< "$output"; then
+    echo "TLS alignment of $file was not changed"
+    exit 1
+  fi
+done
+
+for file in "$test_dir"/empty/*; do
+  if ! grep -qF "Removing VERSYM section from '$file'" <<< "$output" ||
+     grep -qF "dynamic section entry from '$file'" <<< "$output"; then
+    echo "File with an empty dynamic section was not cleaned as expected"
+    exit 1
+  fi
+done
+
+# Everything is clean after one run.
+output="$("$elf_cleaner" --api-level 21 "$test_dir"/*/* 2>&1)"
+if [ -n "$output" ]; then
+  echo "Second run made changes:"
+  echo "$output"
+  exit 1
+fi
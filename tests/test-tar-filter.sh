@@ -0,0 +1,72 @@
+#!/usr/bin/bash
+set -e
+
+if [ $# != 2 ]; then
+  echo "Usage path/to/test-tar-filter.sh <elf-cleaner> <source-dir>"
+  exit 1
+fi
+
+elf_cleaner="$1"
+source_dir="$2"
+test_dir="$(dirname $1)/tests/tar-filter"
+# Longer than the 100 characters of a ustar name field.
+long_dir="usr/share/a-directory-with-a-name-long-enough/to-need-a-long-name-header-in-gnu-and-pax-tar-files"
+
+rm -rf "$test_dir"
+mkdir -p "$test_dir/tree/usr/bin" "$test_dir/tree/$long_dir"
+cd "$test_dir"
+for arch in aarch64 arm i686 x86_64; do
+  cp "$source_dir/tests/curl-7.83.1-$arch-original" "tree/usr/bin/curl-$arch"
+done
+cp "$source_dir/tests/curl-7.83.1-x86_64-original" "tree/$long_dir/libcurl.so"
+seq 1 100000 > tree/usr/share/numbers
+ln -s curl-arm tree/usr/bin/curl
+
+for format in gnu pax; do
+  tar --format=$format -cf $format.tar -C tree .
+
+  # Through pipes, where data is spliced, and between files.
+  cat $format.tar | "$elf_cleaner" --api-level 21 --tar-filter 2> $format.log | cat > $format-cleaned.tar
+  "$elf_cleaner" --api-level 21 --tar-filter < $format.tar > $format-cleaned-files.tar 2> /dev/null
+  if ! cmp -s $format-cleaned.tar $format-cleaned-files.tar; then
+    echo "Output through pipes and files differs for $format"
+    exit 1
+  fi
+  if [ "$(stat -c %s $format.tar)" != "$(stat -c %s $format-cleaned.tar)" ]; then
+    echo "Size of the $format stream changed"
+    exit 1
+  fi
+  if ! grep -qF "Removing the DT_RUNPATH dynamic section entry from './$long_dir/libcurl.so'" $format.log; then
+    echo "Long names are not resolved for $format"
+    exit 1
+  fi
+
+  rm -rf extracted
+  mkdir extracted
+  tar -xf $format-cleaned.tar -C extracted
+  for arch in aarch64 arm i686 x86_64; do
+    if ! cmp -s "$source_dir/tests/curl-7.83.1-$arch-api21-cleaned" "extracted/usr/bin/curl-$arch"; then
+      echo "Expected and actual files differ for curl-$arch in $format"
+      exit 1
+    fi
+  done
+  if ! cmp -s "$source_dir/tests/curl-7.83.1-x86_64-api21-cleaned" "extracted/$long_dir/libcurl.so"; then
+    echo "Expected and actual files differ for the long name in $format"
+    exit 1
+  fi
+  if ! cmp -s tree/usr/share/numbers extracted/usr/share/numbers; then
+    echo "Passed through file differs in $format"
+    exit 1
+  fi
+  if [ "$(readlink extracted/usr/bin/curl)" != curl-arm ]; then
+    echo "Symbolic link lost in $format"
+    exit 1
+  fi
+
+  "$elf_cleaner" --api-level 21 --check --tar-filter < $format-cleaned.tar > /dev/null
+done
+
+if printf 'not a tar header%.0s' $(seq 64) | "$elf_cleaner" --tar-filter > /dev/null 2>&1; then
+  echo "Invalid tar header accepted"
+  exit 1
+fi
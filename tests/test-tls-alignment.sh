@@ -1,8 +1,8 @@
 #!/usr/bin/bash
 set -e
 
-if [ $# != 4 ]; then
-  echo "Usage path/to/test-dynamic-section.sh <elf-cleaner> <source-dir> <binary-name> <arch>"
+if [ $# != 4 ] && [ $# != 5 ]; then
+  echo "Usage path/to/test-dynamic-section.sh <elf-cleaner> <source-dir> <binary-name> <arch> [io-engine]"
   exit 1
 fi
 
@@ -17,6 +17,11 @@ origfile="$basefile-original"
 testfile="$(basename $basefile).test"
 expectedfile="$basefile-tls-aligned"
 test_dir="$(dirname $1)/tests"
+engine_args=()
+if [ $# = 5 ]; then
+  test_dir="$test_dir/$5"
+  engine_args=(--io-engine "$5")
+fi
 
 if [ "$arch" = "aarch64" ] || [ "$arch" = "x86_64" ]; then
   expected_logs="$progname: Changing TLS alignment for '$test_dir/$testfile' to 64, instead of 8"
@@ -29,12 +34,12 @@ fi
 
 mkdir -p "$test_dir"
 cp "$origfile" "$test_dir/$testfile"
-# echo "$elf_cleaner" "$test_dir/$testfile"
-if [ "$("$elf_cleaner" "$test_dir/$testfile")" != "$expected_logs" ]; then
+# echo "$elf_cleaner" "${engine_args[@]}" "$test_dir/$testfile"
+if [ "$("$elf_cleaner" "${engine_args[@]}" "$test_dir/$testfile")" != "$expected_logs" ]; then
   echo "Logs do not match for $testfile"
   exit 1
 fi
-if not cmp -s "$test_dir/$testfile" "$expectedfile"; then
+if ! cmp -s "$test_dir/$testfile" "$expectedfile"; then
   echo "Expected and actual files differ for $testfile"
   exit 1
 fi
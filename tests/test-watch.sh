@@ -0,0 +1,69 @@
+#!/usr/bin/bash
+set -e
+
+if [ $# != 2 ]; then
+  echo "Usage path/to/test-watch.sh <elf-cleaner> <source-dir>"
+  exit 1
+fi
+
+elf_cleaner="$1"
+source_dir="$2"
+test_dir="$(dirname $1)/tests/watch"
+
+rm -rf "$test_dir"
+mkdir -p "$test_dir/tree" "$test_dir/outside"
+cp "$source_dir/tests/curl-7.83.1-aarch64-original" "$test_dir/tree/curl-aarch64"
+
+"$elf_cleaner" --api-level 21 --jobs 2 --exclude '*.txt' --watch "$test_dir/tree" > "$test_dir/output" &
+watch_pid=$!
+trap 'kill $watch_pid 2> /dev/null || true' EXIT
+
+# Written into a new directory, moved in, and written in two steps.
+mkdir -p "$test_dir/tree/usr/bin"
+cp "$source_dir/tests/curl-7.83.1-arm-original" "$test_dir/tree/usr/bin/curl-arm"
+cp "$source_dir/tests/curl-7.83.1-i686-original" "$test_dir/outside/curl-i686"
+mv "$test_dir/outside/curl-i686" "$test_dir/tree/usr/bin/curl-i686"
+head -c 4096 "$source_dir/tests/curl-7.83.1-x86_64-original" > "$test_dir/tree/usr/bin/curl-x86_64"
+sleep 0.05
+tail -c +4097 "$source_dir/tests/curl-7.83.1-x86_64-original" >> "$test_dir/tree/usr/bin/curl-x86_64"
+cp "$source_dir/tests/curl-7.83.1-arm-original" "$test_dir/tree/usr/bin/excluded.txt"
+
+files="curl-aarch64 usr/bin/curl-arm usr/bin/curl-i686 usr/bin/curl-x86_64"
+for i in $(seq 100); do
+  done_count=0
+  for file in $files; do
+    arch=${file##*-}
+    if cmp -s "$source_dir/tests/curl-7.83.1-$arch-api21-cleaned" "$test_dir/tree/$file"; then
+      done_count=$((done_count + 1))
+    fi
+  done
+  [ $done_count = 4 ] && break
+  sleep 0.1
+done
+if [ $done_count != 4 ]; then
+  echo "Only $done_count of 4 watched files were cleaned"
+  exit 1
+fi
+
+# Files still waiting when the watch is stopped are cleaned before it
+# exits.
+cp "$source_dir/tests/curl-7.83.1-arm-original" "$test_dir/tree/usr/bin/late-arm"
+kill $watch_pid
+wait $watch_pid
+if ! cmp -s "$source_dir/tests/curl-7.83.1-arm-api21-cleaned" "$test_dir/tree/usr/bin/late-arm"; then
+  echo "File written before the watch was stopped was not cleaned"
+  exit 1
+fi
+if ! cmp -s "$source_dir/tests/curl-7.83.1-arm-original" "$test_dir/tree/usr/bin/excluded.txt"; then
+  echo "Excluded file was cleaned"
+  exit 1
+fi
+
+for file in $files usr/bin/late-arm; do
+  count=$(grep -cF "DT_RUNPATH dynamic section entry from '$test_dir/tree/$file'" "$test_dir/output" || true)
+  if [ "$count" != 1 ]; then
+    echo "$file was cleaned $count times instead of once"
+    cat "$test_dir/output"
+    exit 1
+  fi
+done
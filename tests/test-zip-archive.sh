@@ -0,0 +1,68 @@
+#!/usr/bin/bash
+set -e
+
+if [ $# != 2 ]; then
+  echo "Usage path/to/test-zip-archive.sh <elf-cleaner> <source-dir>"
+  exit 1
+fi
+
+elf_cleaner="$1"
+source_dir="$2"
+test_dir="$(dirname $1)/tests/zip-archive"
+
+rm -rf "$test_dir"
+mkdir -p "$test_dir/contents/lib/arm64-v8a" "$test_dir/contents/lib/armeabi-v7a" \
+  "$test_dir/contents/lib/x86" "$test_dir/contents/lib/x86_64" "$test_dir/extracted"
+cd "$test_dir/contents"
+cp "$source_dir/tests/curl-7.83.1-aarch64-original" lib/arm64-v8a/libcurl.so
+cp "$source_dir/tests/curl-7.83.1-arm-original" lib/armeabi-v7a/libcurl.so
+cp "$source_dir/tests/curl-7.83.1-i686-original" lib/x86/libcurl.so
+cp "$source_dir/tests/curl-7.83.1-x86_64-original" lib/x86_64/libcurl.so
+# Not where Android looks for native libraries, so left alone.
+cp "$source_dir/tests/curl-7.83.1-x86_64-original" libother.so
+echo "<manifest/>" > AndroidManifest.xml
+
+zip -q -0 ../stored.apk AndroidManifest.xml libother.so lib/*/libcurl.so
+# Written to a pipe, so with data descriptors.
+zip -q -0 - lib/arm64-v8a/libcurl.so lib/x86/libcurl.so > ../streamed.apk
+zip -q -9 ../deflated.apk lib/x86_64/libcurl.so
+cp ../deflated.apk ../deflated-original.apk
+
+cd ..
+if "$elf_cleaner" --api-level 21 --check stored.apk > check-output; then
+  echo "--check found nothing to change in the zip file"
+  exit 1
+fi
+
+"$elf_cleaner" --api-level 21 --jobs 4 stored.apk streamed.apk deflated.apk > output
+if ! grep -qF "Removing the DT_RUNPATH dynamic section entry from 'streamed.apk(lib/x86/libcurl.so)'" output; then
+  echo "Entries of the streamed zip file were not cleaned"
+  exit 1
+fi
+
+for apk in stored.apk streamed.apk; do
+  if ! unzip -tq "$apk" > /dev/null; then
+    echo "CRC-32s of $apk were not updated"
+    unzip -t "$apk"
+    exit 1
+  fi
+done
+if ! cmp -s deflated-original.apk deflated.apk; then
+  echo "Compressed entries were changed"
+  exit 1
+fi
+
+cd extracted
+unzip -q ../stored.apk
+for abi in aarch64:arm64-v8a arm:armeabi-v7a i686:x86 x86_64:x86_64; do
+  if ! cmp -s "$source_dir/tests/curl-7.83.1-${abi%%:*}-api21-cleaned" "lib/${abi#*:}/libcurl.so"; then
+    echo "Expected and actual files differ for lib/${abi#*:}/libcurl.so"
+    exit 1
+  fi
+done
+if ! cmp -s "$source_dir/tests/curl-7.83.1-x86_64-original" libother.so; then
+  echo "Entry outside lib/<abi>/ was changed"
+  exit 1
+fi
+
+"$elf_cleaner" --api-level 21 --check ../stored.apk ../streamed.apk
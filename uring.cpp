@@ -0,0 +1,179 @@
+/* termux-elf-cleaner
+
+Copyright (C) 2026 Termux
+
+This file is part of termux-elf-cleaner.
+
+termux-elf-cleaner is free software: you can redistribute it and/or
+modify it under the terms of the GNU General Public License as
+published by the Free Software Foundation, either version 3 of the
+License, or (at your option) any later version.
+
+termux-elf-cleaner is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with termux-elf-cleaner.  If not, see
+<https://www.gnu.org/licenses/>.  */
+
+#include <errno.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <atomic>
+#include <memory>
+
+#include "uring.h"
+
+/* Room for every operation code in a probe.  */
+#define PROBE_OPS 256
+
+static int io_uring_setup(unsigned entries, io_uring_params* params)
+{
+	return syscall(__NR_io_uring_setup, entries, params);
+}
+
+static int io_uring_enter(int fd, unsigned to_submit, unsigned min_complete, unsigned flags)
+{
+	return syscall(__NR_io_uring_enter, fd, to_submit, min_complete, flags, NULL, 0);
+}
+
+static int io_uring_register(int fd, unsigned opcode, void* arg, unsigned nr_args)
+{
+	return syscall(__NR_io_uring_register, fd, opcode, arg, nr_args);
+}
+
+uring::~uring()
+{
+	if (sqes != nullptr)
+		munmap(sqes, sqes_size);
+	if (cq_ring != nullptr && cq_ring != sq_ring)
+		munmap(cq_ring, cq_ring_size);
+	if (sq_ring != nullptr)
+		munmap(sq_ring, sq_ring_size);
+	if (ring_fd >= 0)
+		close(ring_fd);
+}
+
+bool uring::init(unsigned requested)
+{
+	io_uring_params params;
+	memset(&params, 0, sizeof(params));
+	ring_fd = io_uring_setup(requested, &params);
+	if (ring_fd < 0)
+		return false;
+
+	// Kernels before 5.6 lack the file operations.
+	size_t const probe_size = sizeof(io_uring_probe) + PROBE_OPS * sizeof(io_uring_probe_op);
+	std::unique_ptr<uint8_t[]> probe_buffer(new uint8_t[probe_size]());
+	auto* probe = reinterpret_cast<io_uring_probe*>(probe_buffer.get());
+	if (io_uring_register(ring_fd, IORING_REGISTER_PROBE, probe, PROBE_OPS) < 0)
+		return false;
+	for (int op : {IORING_OP_OPENAT, IORING_OP_STATX, IORING_OP_READ,
+		       IORING_OP_WRITE, IORING_OP_FSYNC, IORING_OP_CLOSE}) {
+		if (op > probe->last_op || !(probe->ops[op].flags & IO_URING_OP_SUPPORTED)) {
+			errno = ENOSYS;
+			return false;
+		}
+	}
+
+	sq_ring_size = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+	cq_ring_size = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+	if (params.features & IORING_FEAT_SINGLE_MMAP)
+		sq_ring_size = cq_ring_size = std::max(sq_ring_size, cq_ring_size);
+	void* mem = mmap(0, sq_ring_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+			 ring_fd, IORING_OFF_SQ_RING);
+	if (mem == MAP_FAILED)
+		return false;
+	sq_ring = mem;
+	if (params.features & IORING_FEAT_SINGLE_MMAP) {
+		cq_ring = sq_ring;
+	} else {
+		mem = mmap(0, cq_ring_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+			   ring_fd, IORING_OFF_CQ_RING);
+		if (mem == MAP_FAILED)
+			return false;
+		cq_ring = mem;
+	}
+	sqes_size = params.sq_entries * sizeof(io_uring_sqe);
+	mem = mmap(0, sqes_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+		   ring_fd, IORING_OFF_SQES);
+	if (mem == MAP_FAILED)
+		return false;
+	sqes = static_cast<io_uring_sqe*>(mem);
+
+	auto* sq = static_cast<uint8_t*>(sq_ring);
+	sq_tail = reinterpret_cast<unsigned*>(sq + params.sq_off.tail);
+	sq_mask = reinterpret_cast<unsigned*>(sq + params.sq_off.ring_mask);
+	sq_array = reinterpret_cast<unsigned*>(sq + params.sq_off.array);
+	auto* cq = static_cast<uint8_t*>(cq_ring);
+	cq_head = reinterpret_cast<unsigned*>(cq + params.cq_off.head);
+	cq_tail = reinterpret_cast<unsigned*>(cq + params.cq_off.tail);
+	cq_mask = reinterpret_cast<unsigned*>(cq + params.cq_off.ring_mask);
+	cqes = reinterpret_cast<io_uring_cqe*>(cq + params.cq_off.cqes);
+	entries = params.sq_entries;
+	return true;
+}
+
+io_uring_sqe* uring::next_sqe()
+{
+	if (broken || queued == entries)
+		return nullptr;
+	// Only this thread adds entries, and the ring is empty between
+	// rounds, so the tail can be read plainly.
+	unsigned const index = (*sq_tail + queued) & *sq_mask;
+	sq_array[index] = index;
+	io_uring_sqe* sqe = &sqes[index];
+	memset(sqe, 0, sizeof(*sqe));
+	queued++;
+	return sqe;
+}
+
+bool uring::run(std::function<void(uint64_t user_data, int32_t res)> const& done)
+{
+	unsigned const count = queued;
+	queued = 0;
+	std::atomic_ref<unsigned>(*sq_tail).store(*sq_tail + count, std::memory_order_release);
+
+	// Operations in flight point into buffers of the caller, so they are
+	// waited for even if submitting the rest failed.
+	unsigned submitted = 0;
+	unsigned completed = 0;
+	int submit_errno = 0;
+	while (completed < submitted || (submit_errno == 0 && submitted < count)) {
+		unsigned const to_submit = submit_errno == 0 ? count - submitted : 0;
+		int const n = io_uring_enter(ring_fd, to_submit, 1, IORING_ENTER_GETEVENTS);
+		if (n < 0 && errno == EINTR)
+			continue;
+		if (n < 0 && to_submit == 0) {
+			// Nothing left to do but wait, and that fails.
+			broken = true;
+			return false;
+		}
+		if (n < 0 || (n == 0 && to_submit != 0 && completed == submitted)) {
+			submit_errno = n < 0 ? errno : EAGAIN;
+			continue;
+		}
+		submitted += to_submit != 0 ? n : 0;
+
+		unsigned head = *cq_head;
+		unsigned const tail = std::atomic_ref<unsigned>(*cq_tail).load(std::memory_order_acquire);
+		for (; head != tail; head++, completed++) {
+			io_uring_cqe const& cqe = cqes[head & *cq_mask];
+			done(cqe.user_data, cqe.res);
+		}
+		std::atomic_ref<unsigned>(*cq_head).store(head, std::memory_order_release);
+	}
+	if (submit_errno != 0) {
+		// The unsubmitted entries are still queued in the ring.
+		broken = true;
+		errno = submit_errno;
+		return false;
+	}
+	return true;
+}
@@ -0,0 +1,77 @@
+/* termux-elf-cleaner
+
+Copyright (C) 2026 Termux
+
+This file is part of termux-elf-cleaner.
+
+termux-elf-cleaner is free software: you can redistribute it and/or
+modify it under the terms of the GNU General Public License as
+published by the Free Software Foundation, either version 3 of the
+License, or (at your option) any later version.
+
+termux-elf-cleaner is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with termux-elf-cleaner.  If not, see
+<https://www.gnu.org/licenses/>.  */
+
+#ifndef ELF_CLEANER_URING_H
+#define ELF_CLEANER_URING_H
+
+#include <stdint.h>
+
+#include <linux/io_uring.h>
+
+#include <functional>
+
+/* An io_uring set up through the system calls themselves, for a single
+   thread that queues a round of operations, submits them in one call
+   and waits for all of them to complete.  */
+class uring {
+public:
+	uring() {}
+	uring(uring const&) = delete;
+	uring& operator=(uring const&) = delete;
+	~uring();
+
+	/* Set up a ring with room for entries operations in a round.
+	   Returns false with errno set if io_uring, or one of the
+	   operations the batch engine uses, is not available.  */
+	bool init(unsigned entries);
+
+	/* A cleared entry for the next operation of the round, or nullptr
+	   if the round is full or a round failed, after which the ring
+	   cannot be used any more.  */
+	io_uring_sqe* next_sqe();
+
+	/* Submit the round and wait until all of it has completed, calling
+	   done with the user_data and result of each operation.  Returns
+	   false with errno set if the round could not be submitted.  */
+	bool run(std::function<void(uint64_t user_data, int32_t res)> const& done);
+
+private:
+	int ring_fd = -1;
+	unsigned entries = 0;
+	unsigned queued = 0;
+	bool broken = false;
+
+	void* sq_ring = nullptr;
+	size_t sq_ring_size = 0;
+	void* cq_ring = nullptr;
+	size_t cq_ring_size = 0;
+	io_uring_sqe* sqes = nullptr;
+	size_t sqes_size = 0;
+
+	unsigned* sq_tail = nullptr;
+	unsigned* sq_mask = nullptr;
+	unsigned* sq_array = nullptr;
+	unsigned* cq_head = nullptr;
+	unsigned* cq_tail = nullptr;
+	unsigned* cq_mask = nullptr;
+	io_uring_cqe* cqes = nullptr;
+};
+
+#endif
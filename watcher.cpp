@@ -0,0 +1,248 @@
+/* termux-elf-cleaner
+
+Copyright (C) 2026 Termux
+
+This file is part of termux-elf-cleaner.
+
+termux-elf-cleaner is free software: you can redistribute it and/or
+modify it under the terms of the GNU General Public License as
+published by the Free Software Foundation, either version 3 of the
+License, or (at your option) any later version.
+
+termux-elf-cleaner is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with termux-elf-cleaner.  If not, see
+<https://www.gnu.org/licenses/>.  */
+
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE
+#endif
+
+#include <dirent.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/inotify.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <chrono>
+#include <functional>
+#include <map>
+#include <string>
+#include <unordered_map>
+
+#include "elf-cleaner.h"
+#include "file-log.h"
+#include "stop-signal.h"
+#include "watcher.h"
+
+/* Events watched for on every directory in the tree.  */
+#define WATCH_MASK (IN_CLOSE_WRITE | IN_MODIFY | IN_MOVED_TO | IN_MOVED_FROM | \
+		    IN_CREATE | IN_DELETE | IN_ONLYDIR | IN_EXCL_UNLINK)
+
+/* Room for many events per read().  */
+#define EVENT_BUFFER_SIZE (64 * 1024)
+
+namespace {
+
+using watch_clock = std::chrono::steady_clock;
+
+class watcher {
+public:
+	watcher(int fd, std::string root, walk_filter const& filter)
+		: fd(fd), root(std::move(root)), filter(filter) {}
+
+	/* Watch the directory at path and those below it, and schedule the
+	   files in them, which may have been written before the watch was
+	   added.  */
+	bool add_tree(std::string const& path)
+	{
+		int const wd = inotify_add_watch(fd, path.c_str(), WATCH_MASK);
+		if (wd < 0) {
+			perror_path("inotify_add_watch", path.c_str());
+			return false;
+		}
+		// A directory moved within the tree keeps its watch, under its
+		// new name.
+		dirs[wd] = path;
+
+		DIR* dir = opendir(path.c_str());
+		if (dir == NULL) {
+			perror_path("opendir", path.c_str());
+			return true;
+		}
+		while (struct dirent* entry = readdir(dir)) {
+			char const* name = entry->d_name;
+			if (name[0] == '.' && (name[1] == 0 || (name[1] == '.' && name[2] == 0)))
+				continue;
+			unsigned char type = entry->d_type;
+			if (type == DT_UNKNOWN) {
+				struct stat st;
+				if (fstatat(dirfd(dir), name, &st, AT_SYMLINK_NOFOLLOW) < 0)
+					continue;
+				type = S_ISDIR(st.st_mode) ? DT_DIR : S_ISREG(st.st_mode) ? DT_REG : DT_UNKNOWN;
+			}
+			std::string child = path + "/" + name;
+			if (type == DT_DIR && filter.accepts_dir(name))
+				add_tree(child);
+			else if (type == DT_REG && filter.accepts_file(name))
+				schedule(child);
+		}
+		closedir(dir);
+		return true;
+	}
+
+	/* Read and act on the events that are ready.  */
+	void read_events()
+	{
+		alignas(struct inotify_event) char buffer[EVENT_BUFFER_SIZE];
+		while (true) {
+			ssize_t const n = read(fd, buffer, sizeof(buffer));
+			if (n < 0 && errno == EINTR)
+				continue;
+			if (n <= 0) {
+				if (n < 0 && errno != EAGAIN)
+					log_perror("read()");
+				return;
+			}
+			for (ssize_t pos = 0; pos < n;) {
+				auto const* event = reinterpret_cast<struct inotify_event const*>(buffer + pos);
+				pos += sizeof(struct inotify_event) + event->len;
+				handle(*event);
+			}
+		}
+	}
+
+	/* Milliseconds until the next file is due, or -1 if none is waiting.  */
+	int timeout() const
+	{
+		if (pending.empty())
+			return -1;
+		auto next = watch_clock::time_point::max();
+		for (auto const& [path, due] : pending)
+			next = std::min(next, due);
+		auto const left = std::chrono::ceil<std::chrono::milliseconds>(next - watch_clock::now());
+		return std::max<long long>(left.count(), 0);
+	}
+
+	/* Pass on the files that are due, or all waiting files if all.  */
+	void pass_due(std::function<void(std::string const& path)> const& on_file, bool all)
+	{
+		auto const now = watch_clock::now();
+		for (auto it = pending.begin(); it != pending.end();) {
+			if (all || it->second <= now) {
+				on_file(it->first);
+				it = pending.erase(it);
+			} else {
+				++it;
+			}
+		}
+	}
+
+private:
+	void handle(struct inotify_event const& event)
+	{
+		if (event.mask & IN_Q_OVERFLOW) {
+			// Events were lost, so look at everything again.
+			add_tree(root);
+			return;
+		}
+		if (event.mask & IN_IGNORED) {
+			dirs.erase(event.wd);
+			return;
+		}
+		auto const dir = dirs.find(event.wd);
+		if (dir == dirs.end() || event.len == 0)
+			return;
+		char const* name = event.name;
+		std::string path = dir->second + "/" + name;
+
+		if (event.mask & IN_ISDIR) {
+			if ((event.mask & (IN_CREATE | IN_MOVED_TO)) && filter.accepts_dir(name))
+				add_tree(path);
+			return;
+		}
+		if (!filter.accepts_file(name))
+			return;
+		if (event.mask & (IN_DELETE | IN_MOVED_FROM)) {
+			pending.erase(path);
+		} else if (event.mask & IN_CLOSE_WRITE) {
+			schedule(std::move(path));
+		} else if (event.mask & IN_MOVED_TO) {
+			// Symbolic links are left alone, as with --recursive.
+			struct stat st;
+			if (lstat(path.c_str(), &st) == 0 && S_ISREG(st.st_mode))
+				schedule(std::move(path));
+		} else if (event.mask & IN_MODIFY) {
+			// Still being written: wait for it to be left alone.
+			auto const it = pending.find(path);
+			if (it != pending.end())
+				it->second = watch_clock::now() + std::chrono::milliseconds(WATCH_DELAY_MS);
+		}
+	}
+
+	void schedule(std::string path)
+	{
+		pending[std::move(path)] = watch_clock::now() + std::chrono::milliseconds(WATCH_DELAY_MS);
+	}
+
+	int fd;
+	std::string root;
+	walk_filter const& filter;
+	std::unordered_map<int, std::string> dirs;
+	/* Files waiting to be passed on, by name, with when they are due.  */
+	std::map<std::string, watch_clock::time_point> pending;
+};
+
+}
+
+int watch_tree(std::string const& root, walk_filter const& filter,
+	       std::function<void(std::string const& path)> const& on_file)
+{
+	int const stop_fd = stop_signal_fd();
+	if (stop_fd < 0)
+		return 1;
+	int const fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+	if (fd < 0) {
+		log_perror("inotify_init1()");
+		return 1;
+	}
+
+	std::string path = root;
+	while (path.size() > 1 && path.back() == '/')
+		path.pop_back();
+	watcher w(fd, path, filter);
+	if (!w.add_tree(path)) {
+		close(fd);
+		return 1;
+	}
+
+	struct pollfd fds[2] = {
+		{fd, POLLIN, 0},
+		{stop_fd, POLLIN, 0},
+	};
+	while (true) {
+		int const n = poll(fds, 2, w.timeout());
+		if (n < 0 && errno != EINTR) {
+			log_perror("poll()");
+			break;
+		}
+		if (n > 0 && fds[1].revents != 0)
+			break;
+		if (n > 0 && fds[0].revents != 0)
+			w.read_events();
+		w.pass_due(on_file, false);
+	}
+
+	// Whatever was written before the signal is done by now.
+	w.read_events();
+	w.pass_due(on_file, true);
+	close(fd);
+	return 0;
+}
@@ -0,0 +1,44 @@
+/* termux-elf-cleaner
+
+Copyright (C) 2026 Termux
+
+This file is part of termux-elf-cleaner.
+
+termux-elf-cleaner is free software: you can redistribute it and/or
+modify it under the terms of the GNU General Public License as
+published by the Free Software Foundation, either version 3 of the
+License, or (at your option) any later version.
+
+termux-elf-cleaner is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with termux-elf-cleaner.  If not, see
+<https://www.gnu.org/licenses/>.  */
+
+#ifndef ELF_CLEANER_WATCHER_H
+#define ELF_CLEANER_WATCHER_H
+
+#include <functional>
+#include <string>
+
+#include "dir-walker.h"
+
+/* How long a file has to be left alone after it was written before it
+   is passed on, so that files written in several steps, such as those
+   stripped or relinked after they were installed, are cleaned once.  */
+#define WATCH_DELAY_MS 200
+
+/* Watch the tree below root with inotify and call on_file for every
+   regular file accepted by filter that is closed after writing or moved
+   into it, once WATCH_DELAY_MS have passed without it being written to,
+   starting with the files already there.  Directories created in the
+   tree are watched too.  Runs until SIGINT or SIGTERM and then passes
+   on the files still waiting.  Returns 0, or 1 if root cannot be
+   watched.  */
+int watch_tree(std::string const& root, walk_filter const& filter,
+	       std::function<void(std::string const& path)> const& on_file);
+
+#endif
@@ -0,0 +1,174 @@
+/* termux-elf-cleaner
+
+Copyright (C) 2026 Termux
+
+This file is part of termux-elf-cleaner.
+
+termux-elf-cleaner is free software: you can redistribute it and/or
+modify it under the terms of the GNU General Public License as
+published by the Free Software Foundation, either version 3 of the
+License, or (at your option) any later version.
+
+termux-elf-cleaner is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with termux-elf-cleaner.  If not, see
+<https://www.gnu.org/licenses/>.  */
+
+#include <algorithm>
+
+#include "worker-pool.h"
+
+static thread_local int worker_index = -1;
+
+worker_pool::worker_pool(unsigned int workers, size_t max_pending)
+	: slots(max_pending)
+{
+	if (workers < 1)
+		workers = 1;
+	for (unsigned int i = 0; i < workers; i++)
+		queues.push_back(std::make_unique<queue>());
+	for (unsigned int i = 0; i < workers; i++)
+		threads.emplace_back(&worker_pool::run, this, i);
+}
+
+worker_pool::~worker_pool()
+{
+	wait();
+	{
+		std::lock_guard<std::mutex> guard(idle_lock);
+		stopping = true;
+	}
+	idle_cond.notify_all();
+	for (auto& thread : threads)
+		thread.join();
+}
+
+int worker_pool::current_worker()
+{
+	return worker_index;
+}
+
+void worker_pool::submit(std::function<void()> task)
+{
+	int const self = worker_index;
+	if (self >= 0) {
+		// Blocking here could leave every worker waiting on itself.
+		if (!slots.try_acquire()) {
+			task();
+			return;
+		}
+	} else {
+		slots.acquire();
+	}
+
+	unsigned int const target = (self >= 0) ? (unsigned int) self :
+		next_queue.fetch_add(1, std::memory_order_relaxed) % queues.size();
+	unfinished.fetch_add(1);
+	{
+		std::lock_guard<std::mutex> guard(queues[target]->lock);
+		queues[target]->tasks.push_back(std::move(task));
+		queued.fetch_add(1);
+	}
+	{
+		// Pairs with the predicate check in run() so the wakeup is not lost.
+		std::lock_guard<std::mutex> guard(idle_lock);
+	}
+	idle_cond.notify_one();
+}
+
+void worker_pool::wait()
+{
+	std::unique_lock<std::mutex> guard(idle_lock);
+	done_cond.wait(guard, [this] { return unfinished.load() == 0; });
+}
+
+void worker_pool::parallel_for(size_t count, std::function<void(size_t)> const& body)
+{
+	struct group {
+		std::function<void(size_t)> const* body;
+		size_t count;
+		std::atomic<size_t> next{0};
+		std::atomic<size_t> done{0};
+		std::mutex lock;
+		std::condition_variable done_cond;
+	};
+	auto g = std::make_shared<group>();
+	g->body = &body;
+	g->count = count;
+
+	// Helpers that start after every index was claimed return without
+	// touching body, which may be gone by then.
+	auto claim = [g]() {
+		size_t finished = 0;
+		for (size_t i; (i = g->next.fetch_add(1)) < g->count; finished++)
+			(*g->body)(i);
+		if (finished != 0 && g->done.fetch_add(finished) + finished == g->count) {
+			std::lock_guard<std::mutex> guard(g->lock);
+			g->done_cond.notify_all();
+		}
+	};
+
+	size_t const helpers = std::min<size_t>(count, queues.size()) - (count ? 1 : 0);
+	for (size_t i = 0; i < helpers && g->next.load() < count; i++)
+		submit(claim);
+	claim();
+
+	std::unique_lock<std::mutex> guard(g->lock);
+	g->done_cond.wait(guard, [&g] { return g->done.load() == g->count; });
+}
+
+bool worker_pool::pop(unsigned int index, std::function<void()>& task)
+{
+	{
+		queue& own = *queues[index];
+		std::lock_guard<std::mutex> guard(own.lock);
+		if (!own.tasks.empty()) {
+			task = std::move(own.tasks.front());
+			own.tasks.pop_front();
+			queued.fetch_sub(1);
+			return true;
+		}
+	}
+	for (size_t i = 1; i < queues.size(); i++) {
+		queue& victim = *queues[(index + i) % queues.size()];
+		std::lock_guard<std::mutex> guard(victim.lock);
+		if (!victim.tasks.empty()) {
+			task = std::move(victim.tasks.back());
+			victim.tasks.pop_back();
+			queued.fetch_sub(1);
+			return true;
+		}
+	}
+	return false;
+}
+
+void worker_pool::finish()
+{
+	slots.release();
+	if (unfinished.fetch_sub(1) == 1) {
+		std::lock_guard<std::mutex> guard(idle_lock);
+		done_cond.notify_all();
+	}
+}
+
+void worker_pool::run(unsigned int index)
+{
+	worker_index = index;
+	std::function<void()> task;
+	while (true) {
+		if (pop(index, task)) {
+			task();
+			task = nullptr;
+			finish();
+			continue;
+		}
+		std::unique_lock<std::mutex> guard(idle_lock);
+		idle_cond.wait(guard, [this] { return stopping || queued.load() > 0; });
+		if (stopping && queued.load() == 0)
+			return;
+	}
+}
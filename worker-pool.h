@@ -0,0 +1,92 @@
+/* termux-elf-cleaner
+
+Copyright (C) 2026 Termux
+
+This file is part of termux-elf-cleaner.
+
+termux-elf-cleaner is free software: you can redistribute it and/or
+modify it under the terms of the GNU General Public License as
+published by the Free Software Foundation, either version 3 of the
+License, or (at your option) any later version.
+
+termux-elf-cleaner is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with termux-elf-cleaner.  If not, see
+<https://www.gnu.org/licenses/>.  */
+
+#ifndef ELF_CLEANER_WORKER_POOL_H
+#define ELF_CLEANER_WORKER_POOL_H
+
+#include <stddef.h>
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <semaphore>
+#include <thread>
+#include <vector>
+
+/* A fixed set of long-lived worker threads, each with its own task
+   deque.  Idle workers steal from the back of the other deques.
+
+   At most max_pending tasks submitted from outside the pool are queued
+   or running at any time, so submit() blocks instead of letting the
+   queues grow with the number of input files.  Tasks may submit further
+   tasks; when the pool is full those run inline on the submitting
+   worker rather than blocking it.  */
+class worker_pool {
+public:
+	worker_pool(unsigned int workers, size_t max_pending);
+	~worker_pool();
+
+	worker_pool(worker_pool const&) = delete;
+	worker_pool& operator=(worker_pool const&) = delete;
+
+	void submit(std::function<void()> task);
+
+	/* Block until every submitted task has finished.  */
+	void wait();
+
+	/* Run body(0) .. body(count - 1) spread over idle workers, with the
+	   calling thread taking part, and return once all have finished.
+	   May be called from a task: the caller only waits for calls that
+	   are already running on other workers, never for queued ones.  */
+	void parallel_for(size_t count, std::function<void(size_t)> const& body);
+
+	unsigned int size() const { return queues.size(); }
+
+	/* Index of the calling worker thread in its pool, or -1 when
+	   called from a thread that is not a pool worker.  */
+	static int current_worker();
+
+private:
+	struct queue {
+		std::mutex lock;
+		std::deque<std::function<void()>> tasks;
+	};
+
+	void run(unsigned int index);
+	bool pop(unsigned int index, std::function<void()>& task);
+	void finish();
+
+	std::vector<std::unique_ptr<queue>> queues;
+	std::vector<std::thread> threads;
+	std::counting_semaphore<> slots;
+
+	std::mutex idle_lock;
+	std::condition_variable idle_cond;
+	std::condition_variable done_cond;
+	std::atomic<size_t> queued{0};
+	std::atomic<size_t> unfinished{0};
+	std::atomic<unsigned int> next_queue{0};
+	bool stopping = false;
+};
+
+#endif
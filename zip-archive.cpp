@@ -0,0 +1,294 @@
+/* termux-elf-cleaner
+
+Copyright (C) 2026 Termux
+
+This file is part of termux-elf-cleaner.
+
+termux-elf-cleaner is free software: you can redistribute it and/or
+modify it under the terms of the GNU General Public License as
+published by the Free Software Foundation, either version 3 of the
+License, or (at your option) any later version.
+
+termux-elf-cleaner is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with termux-elf-cleaner.  If not, see
+<https://www.gnu.org/licenses/>.  */
+
+#include <string.h>
+
+#include <array>
+
+#if defined(__ARM_FEATURE_CRC32)
+#include <arm_acle.h>
+#endif
+
+#include "zip-archive.h"
+
+#define ZIP_CENTRAL_MAGIC 0x02014b50
+#define ZIP_LOCAL_MAGIC 0x04034b50
+#define ZIP_DESCRIPTOR_MAGIC 0x08074b50
+#define ZIP_END_MAGIC 0x06054b50
+#define ZIP64_END_MAGIC 0x06064b50
+#define ZIP64_LOCATOR_MAGIC 0x07064b50
+#define ZIP64_EXTRA_ID 0x0001
+
+#define ZIP_CENTRAL_SIZE 46
+#define ZIP_LOCAL_SIZE 30
+#define ZIP_END_SIZE 22
+#define ZIP64_END_SIZE 56
+#define ZIP64_LOCATOR_SIZE 20
+/* The end of central directory record may be followed by a comment of
+   up to this many bytes.  */
+#define ZIP_MAX_COMMENT 0xffff
+
+#define ZIP_FLAG_ENCRYPTED 0x0001
+#define ZIP_FLAG_DESCRIPTOR 0x0008
+#define ZIP_METHOD_STORED 0
+
+/* Reflected CRC-32 polynomial used by zip.  */
+#define CRC32_POLY 0xedb88320
+
+static uint64_t read_le(uint8_t const* p, size_t size)
+{
+	uint64_t value = 0;
+	for (size_t i = size; i > 0; i--)
+		value = (value << 8) | p[i - 1];
+	return value;
+}
+
+static uint16_t read16(uint8_t const* p) { return read_le(p, 2); }
+static uint32_t read32(uint8_t const* p) { return read_le(p, 4); }
+static uint64_t read64(uint8_t const* p) { return read_le(p, 8); }
+
+/* Whether name is lib/<abi>/<name>.so, where Android looks for native
+   libraries.  */
+static bool is_native_library(std::string const& name)
+{
+	if (!name.starts_with("lib/") || !name.ends_with(".so"))
+		return false;
+	size_t const slash = name.find('/', 4);
+	return slash != std::string::npos && slash > 4 &&
+		name.find('/', slash + 1) == std::string::npos &&
+		name.size() > slash + 1 + 3;
+}
+
+/* Find the central directory from the end of central directory record,
+   or the zip64 one.  */
+static bool find_central_directory(std::span<uint8_t const> bytes,
+				   size_t& offset, size_t& size, uint64_t& count)
+{
+	if (bytes.size() < ZIP_END_SIZE)
+		return false;
+	size_t end = bytes.size() - ZIP_END_SIZE;
+	size_t const lowest = end > ZIP_MAX_COMMENT ? end - ZIP_MAX_COMMENT : 0;
+	while (read32(bytes.data() + end) != ZIP_END_MAGIC) {
+		if (end == lowest)
+			return false;
+		end--;
+	}
+
+	uint8_t const* record = bytes.data() + end;
+	count = read16(record + 10);
+	size = read32(record + 12);
+	offset = read32(record + 16);
+	if (count != 0xffff && size != 0xffffffff && offset != 0xffffffff)
+		return offset <= bytes.size() && size <= bytes.size() - offset;
+
+	if (end < ZIP64_LOCATOR_SIZE)
+		return false;
+	uint8_t const* locator = record - ZIP64_LOCATOR_SIZE;
+	if (read32(locator) != ZIP64_LOCATOR_MAGIC)
+		return false;
+	uint64_t const end64 = read64(locator + 8);
+	if (end64 > bytes.size() || bytes.size() - end64 < ZIP64_END_SIZE)
+		return false;
+	uint8_t const* record64 = bytes.data() + end64;
+	if (read32(record64) != ZIP64_END_MAGIC)
+		return false;
+	count = read64(record64 + 32);
+	uint64_t const size64 = read64(record64 + 40);
+	uint64_t const offset64 = read64(record64 + 48);
+	if (offset64 > bytes.size() || size64 > bytes.size() - offset64)
+		return false;
+	offset = offset64;
+	size = size64;
+	return true;
+}
+
+/* Replace the 32-bit sizes and offset of a central directory entry that
+   are all ones with their values from its zip64 extra field.  */
+static bool read_zip64_extra(uint8_t const* extra, size_t extra_size,
+			     uint64_t& uncompressed_size, uint64_t& compressed_size,
+			     uint64_t& local_offset)
+{
+	uint64_t* const fields[] = {&uncompressed_size, &compressed_size, &local_offset};
+	while (extra_size >= 4) {
+		uint16_t const id = read16(extra);
+		uint16_t const length = read16(extra + 2);
+		if (length > extra_size - 4)
+			return false;
+		if (id == ZIP64_EXTRA_ID) {
+			uint8_t const* p = extra + 4;
+			for (uint64_t* field : fields) {
+				if (*field != 0xffffffff)
+					continue;
+				if (p + 8 > extra + 4 + length)
+					return false;
+				*field = read64(p);
+				p += 8;
+			}
+			return true;
+		}
+		extra += 4 + length;
+		extra_size -= 4 + length;
+	}
+	return true;
+}
+
+bool parse_zip_entries(std::span<uint8_t const> bytes, std::vector<zip_entry>& entries)
+{
+	size_t directory_offset, directory_size;
+	uint64_t count;
+	if (!find_central_directory(bytes, directory_offset, directory_size, count))
+		return false;
+
+	uint8_t const* p = bytes.data() + directory_offset;
+	uint8_t const* const directory_end = p + directory_size;
+	for (uint64_t i = 0; i < count; i++) {
+		if (directory_end - p < ZIP_CENTRAL_SIZE || read32(p) != ZIP_CENTRAL_MAGIC)
+			return false;
+		uint16_t const flags = read16(p + 8);
+		uint16_t const method = read16(p + 10);
+		uint32_t const crc = read32(p + 16);
+		uint64_t compressed_size = read32(p + 20);
+		uint64_t uncompressed_size = read32(p + 24);
+		uint16_t const name_size = read16(p + 28);
+		uint16_t const extra_size = read16(p + 30);
+		uint16_t const comment_size = read16(p + 32);
+		uint64_t local_offset = read32(p + 42);
+		size_t const central_crc_offset = (p + 16) - bytes.data();
+		uint8_t const* const name_start = p + ZIP_CENTRAL_SIZE;
+		if ((size_t) (directory_end - name_start) < (size_t) name_size + extra_size + comment_size)
+			return false;
+		if (!read_zip64_extra(name_start + name_size, extra_size,
+				      uncompressed_size, compressed_size, local_offset))
+			return false;
+		std::string name(reinterpret_cast<char const*>(name_start), name_size);
+		p = name_start + name_size + extra_size + comment_size;
+
+		if (method != ZIP_METHOD_STORED || (flags & ZIP_FLAG_ENCRYPTED) != 0 ||
+		    compressed_size != uncompressed_size || !is_native_library(name))
+			continue;
+
+		if (local_offset > bytes.size() || bytes.size() - local_offset < ZIP_LOCAL_SIZE)
+			return false;
+		uint8_t const* local = bytes.data() + local_offset;
+		if (read32(local) != ZIP_LOCAL_MAGIC)
+			return false;
+		size_t const data_offset = local_offset + ZIP_LOCAL_SIZE +
+			read16(local + 26) + read16(local + 28);
+		if (data_offset > bytes.size() || uncompressed_size > bytes.size() - data_offset)
+			return false;
+
+		zip_entry entry = {data_offset, (size_t) uncompressed_size, std::move(name), crc, {}};
+		// With a data descriptor, the local header usually has no CRC.
+		if ((flags & ZIP_FLAG_DESCRIPTOR) == 0 || read32(local + 14) == crc)
+			entry.crc_offsets.push_back(local_offset + 14);
+		entry.crc_offsets.push_back(central_crc_offset);
+		if ((flags & ZIP_FLAG_DESCRIPTOR) != 0) {
+			// The descriptor's signature is optional.
+			size_t descriptor = data_offset + uncompressed_size;
+			if (bytes.size() - descriptor >= 8 &&
+			    read32(bytes.data() + descriptor) == ZIP_DESCRIPTOR_MAGIC)
+				descriptor += 4;
+			if (bytes.size() - descriptor < 4 ||
+			    read32(bytes.data() + descriptor) != crc)
+				return false;
+			entry.crc_offsets.push_back(descriptor);
+		}
+		entries.push_back(std::move(entry));
+	}
+	return true;
+}
+
+namespace {
+
+constexpr std::array<uint32_t, 256> make_crc_table()
+{
+	std::array<uint32_t, 256> table = {};
+	for (uint32_t n = 0; n < 256; n++) {
+		uint32_t c = n;
+		for (int k = 0; k < 8; k++)
+			c = c & 1 ? (c >> 1) ^ CRC32_POLY : c >> 1;
+		table[n] = c;
+	}
+	return table;
+}
+
+constexpr auto crc_table = make_crc_table();
+
+/* a * b modulo the polynomial, with bit 31 standing for x^0.  */
+constexpr uint32_t multiply_mod(uint32_t a, uint32_t b)
+{
+	uint32_t product = 0;
+	for (uint32_t m = 1u << 31; m != 0; m >>= 1) {
+		if (a & m)
+			product ^= b;
+		b = b & 1 ? (b >> 1) ^ CRC32_POLY : b >> 1;
+	}
+	return product;
+}
+
+/* x^(2^n) modulo the polynomial, for all shifts of a 64-bit byte
+   count.  */
+constexpr std::array<uint32_t, 67> make_power_table()
+{
+	std::array<uint32_t, 67> table = {};
+	uint32_t p = 1u << 30;
+	for (auto& power : table) {
+		power = p;
+		p = multiply_mod(p, p);
+	}
+	return table;
+}
+
+constexpr auto power_table = make_power_table();
+
+/* Feed byte into the CRC register, without the initial and final
+   inversion.  */
+inline uint32_t crc32_byte(uint32_t crc, uint8_t byte)
+{
+#if defined(__ARM_FEATURE_CRC32)
+	return __crc32b(crc, byte);
+#else
+	return crc_table[(crc ^ byte) & 0xff] ^ (crc >> 8);
+#endif
+}
+
+/* crc after feeding it size zero bytes, by multiplying with x^(8 size).  */
+uint32_t crc32_shift(uint32_t crc, uint64_t size)
+{
+	for (size_t k = 3; size != 0; size >>= 1, k++)
+		if (size & 1)
+			crc = multiply_mod(power_table[k], crc);
+	return crc;
+}
+
+}
+
+uint32_t zip_crc32_patch(uint32_t crc, size_t size, size_t offset,
+			 uint8_t const* old_bytes, uint8_t const* new_bytes, size_t length)
+{
+	// The CRC is linear in the data apart from its initial and final
+	// inversion, which cancel out between the old and new contents, so
+	// the change is the raw CRC of old XOR new.  Zero bytes in front of
+	// the change add nothing to it, those after it shift it.
+	uint32_t delta = 0;
+	for (size_t i = 0; i < length; i++)
+		delta = crc32_byte(delta, old_bytes[i] ^ new_bytes[i]);
+	return crc ^ crc32_shift(delta, size - offset - length);
+}
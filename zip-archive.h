@@ -0,0 +1,60 @@
+/* termux-elf-cleaner
+
+Copyright (C) 2026 Termux
+
+This file is part of termux-elf-cleaner.
+
+termux-elf-cleaner is free software: you can redistribute it and/or
+modify it under the terms of the GNU General Public License as
+published by the Free Software Foundation, either version 3 of the
+License, or (at your option) any later version.
+
+termux-elf-cleaner is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with termux-elf-cleaner.  If not, see
+<https://www.gnu.org/licenses/>.  */
+
+#ifndef ELF_CLEANER_ZIP_ARCHIVE_H
+#define ELF_CLEANER_ZIP_ARCHIVE_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <span>
+#include <string>
+#include <vector>
+
+#define ZIP_MAGIC "PK\3\4"
+#define ZIP_MAGIC_SIZE 4
+
+struct zip_entry {
+	/* Where the entry's stored contents start in the file, and their
+	   size.  */
+	size_t offset;
+	size_t size;
+	std::string name;
+	uint32_t crc;
+	/* Offsets of the copies of the CRC-32 in the local header, the
+	   central directory and the data descriptor, if any.  */
+	std::vector<size_t> crc_offsets;
+};
+
+/* Read the entries of the zip file in bytes that hold native libraries
+   the way Android loads them uncompressed: stored, unencrypted entries
+   named lib/<abi>/<name>.so.  Entries are found through the central
+   directory, so zip64 files and entries with data descriptors are
+   handled.  Returns false if the file is malformed.  */
+bool parse_zip_entries(std::span<uint8_t const> bytes, std::vector<zip_entry>& entries);
+
+/* The CRC-32 of an entry of size bytes with CRC-32 crc after the length
+   bytes at offset in it changed from old_bytes to new_bytes.  Takes time
+   in the number of changed bytes and the logarithm of size, not in
+   size.  */
+uint32_t zip_crc32_patch(uint32_t crc, size_t size, size_t offset,
+			 uint8_t const* old_bytes, uint8_t const* new_bytes, size_t length);
+
+#endif